@@ -0,0 +1,84 @@
+//
+//  PMBenchmark.h
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Returns the current time of a monotonic clock, in seconds.
+ **/
+extern NSTimeInterval PMBenchmarkNow(void);
+
+/**
+ * Returns the peak resident set size of the process, in bytes.
+ * @discussion The peak is never reset: measure each workload in its own process to get its own peak.
+ **/
+extern unsigned long long PMBenchmarkPeakResidentSize(void);
+
+/**
+ * Measures a benchmark workload.
+ *
+ * A workload is measured as a sequence of samples. Each sample times a block performing one or more operations.
+ * Throughput is computed over all operations, latency percentiles over the samples.
+ **/
+@interface PMBenchmark : NSObject
+
+/**
+ * Default initializer.
+ * @param name The name of the workload.
+ **/
+- (id)initWithName:(NSString*)name;
+
+/**
+ * The name of the workload.
+ **/
+@property (nonatomic, strong, readonly) NSString *name;
+
+/**
+ * Times the given block as a single sample.
+ * @param count The number of operations performed by the block.
+ * @param block The block to time.
+ * @discussion This method is thread safe: samples can be measured concurrently.
+ **/
+- (void)measureOperations:(NSUInteger)count usingBlock:(void (^)())block;
+
+/**
+ * Times the whole workload, typically a block measuring samples concurrently.
+ * @param block The block to time.
+ * @discussion Concurrent samples overlap: when a workload is timed with this method, throughput is computed over its wall clock time instead of the sum of the sample latencies.
+ **/
+- (void)measureWallClockUsingBlock:(void (^)())block;
+
+/**
+ * Adds an additional value to the results of the workload (ie. a size ratio or a speedup).
+ * @param value A JSON serializable value.
+ * @param key The name of the value.
+ **/
+- (void)setMetric:(id)value forKey:(NSString*)key;
+
+/**
+ * Returns the results of the workload: operations, total (or wall clock) time, throughput, p50 and p99 sample latencies, peak RSS and additional metrics.
+ **/
+- (NSDictionary*)dictionaryRepresentation;
+
+@end
@@ -0,0 +1,163 @@
+//
+//  PMBenchmark.m
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import "PMBenchmark.h"
+
+#include <sys/resource.h>
+#include <time.h>
+
+NSTimeInterval PMBenchmarkNow(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    
+    return (NSTimeInterval)time.tv_sec + (NSTimeInterval)time.tv_nsec / 1e9;
+}
+
+unsigned long long PMBenchmarkPeakResidentSize(void)
+{
+    struct rusage usage;
+    
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    
+#if defined(__APPLE__)
+    return (unsigned long long)usage.ru_maxrss;
+#else
+    // Linux reports kilobytes.
+    return (unsigned long long)usage.ru_maxrss * 1024;
+#endif
+}
+
+@implementation PMBenchmark
+{
+    NSLock *_lock;
+    NSMutableArray *_samples;
+    NSUInteger _operations;
+    NSTimeInterval _time;
+    NSTimeInterval _wallTime;
+    NSMutableDictionary *_metrics;
+}
+
+- (id)initWithName:(NSString*)name
+{
+    self = [super init];
+    if (self)
+    {
+        _name = name;
+        _lock = [[NSLock alloc] init];
+        _samples = [NSMutableArray array];
+        _operations = 0;
+        _time = 0;
+        _wallTime = 0;
+        _metrics = [NSMutableDictionary dictionary];
+    }
+    return self;
+}
+
+#pragma mark Public Methods
+
+- (void)measureOperations:(NSUInteger)count usingBlock:(void (^)())block
+{
+    NSTimeInterval start = PMBenchmarkNow();
+    
+    @autoreleasepool
+    {
+        block();
+    }
+    
+    NSTimeInterval time = PMBenchmarkNow() - start;
+    
+    [_lock lock];
+    [_samples addObject:@(time)];
+    _operations += count;
+    _time += time;
+    [_lock unlock];
+}
+
+- (void)measureWallClockUsingBlock:(void (^)())block
+{
+    NSTimeInterval start = PMBenchmarkNow();
+    
+    @autoreleasepool
+    {
+        block();
+    }
+    
+    NSTimeInterval time = PMBenchmarkNow() - start;
+    
+    [_lock lock];
+    _wallTime += time;
+    [_lock unlock];
+}
+
+- (void)setMetric:(id)value forKey:(NSString*)key
+{
+    [_lock lock];
+    _metrics[key] = value;
+    [_lock unlock];
+}
+
+- (NSDictionary*)dictionaryRepresentation
+{
+    [_lock lock];
+    
+    NSArray *samples = [_samples sortedArrayUsingSelector:@selector(compare:)];
+    
+    NSMutableDictionary *dictionary = [NSMutableDictionary dictionary];
+    
+    // Sample latencies overlap when measured concurrently.
+    NSTimeInterval time = _wallTime > 0 ? _wallTime : _time;
+    
+    dictionary[@"name"] = _name;
+    dictionary[@"operations"] = @(_operations);
+    dictionary[@"samples"] = @(samples.count);
+    dictionary[@"seconds"] = @(time);
+    dictionary[@"throughput"] = @(time > 0 ? _operations / time : 0);
+    dictionary[@"latency_p50_us"] = @([self pmd_percentile:0.50 ofSortedSamples:samples] * 1e6);
+    dictionary[@"latency_p99_us"] = @([self pmd_percentile:0.99 ofSortedSamples:samples] * 1e6);
+    dictionary[@"peak_rss_bytes"] = @(PMBenchmarkPeakResidentSize());
+    
+    if (_metrics.count > 0)
+        dictionary[@"metrics"] = [_metrics copy];
+    
+    [_lock unlock];
+    
+    return dictionary;
+}
+
+#pragma mark Private Methods
+
+- (NSTimeInterval)pmd_percentile:(double)percentile ofSortedSamples:(NSArray*)samples
+{
+    if (samples.count == 0)
+        return 0;
+    
+    NSUInteger index = (NSUInteger)ceil(percentile * samples.count);
+    index = MIN(MAX(index, 1), samples.count) - 1;
+    
+    return [samples[index] doubleValue];
+}
+
+@end
@@ -0,0 +1,48 @@
+//
+//  PMBenchmarkObject.h
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import "PMBaseObject.h"
+
+/**
+ * Synthetic model object of configurable size used by the benchmarks.
+ **/
+@interface PMBenchmarkObject : PMBaseObject
+
+/**
+ * Fills all persistent properties with deterministic values.
+ * @param seed The seed of the generated values.
+ * @param payloadSize The approximate length in characters of the `payload` property.
+ * @discussion Generated text is built from a small vocabulary of words and URLs, so it compresses like real payloads.
+ **/
+- (void)fillWithSeed:(NSUInteger)seed payloadSize:(NSUInteger)payloadSize;
+
+@property (nonatomic, strong) NSString *title;
+@property (nonatomic, strong) NSString *payload;
+@property (nonatomic, strong) NSURL *url;
+@property (nonatomic, strong) NSArray *tags;
+
+@property (nonatomic, assign) NSInteger counter;
+@property (nonatomic, assign) double score;
+
+@end
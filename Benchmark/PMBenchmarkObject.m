@@ -0,0 +1,69 @@
+//
+//  PMBenchmarkObject.m
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import "PMBenchmarkObject.h"
+
+static NSString * const PMBenchmarkObjectWords[] = {
+    @"video", @"user", @"channel", @"comment", @"like", @"share", @"public", @"private",
+    @"music", @"sports", @"news", @"gaming", @"travel", @"food", @"live", @"featured",
+};
+
+static NSUInteger const PMBenchmarkObjectWordCount = sizeof(PMBenchmarkObjectWords) / sizeof(PMBenchmarkObjectWords[0]);
+
+@implementation PMBenchmarkObject
+
++ (NSArray*)pmd_persistentPropertyNames
+{
+    return @[mjz_key(title),
+             mjz_key(payload),
+             mjz_key(url),
+             mjz_key(tags),
+             mjz_key(counter),
+             mjz_key(score),
+             ];
+}
+
+#pragma mark Public Methods
+
+- (void)fillWithSeed:(NSUInteger)seed payloadSize:(NSUInteger)payloadSize
+{
+    NSMutableString *payload = [NSMutableString stringWithCapacity:payloadSize + 16];
+    NSUInteger state = seed * 2654435761u + 1;
+    
+    while (payload.length < payloadSize)
+    {
+        state = state * 1103515245 + 12345;
+        [payload appendString:PMBenchmarkObjectWords[(state >> 16) % PMBenchmarkObjectWordCount]];
+        [payload appendString:@" "];
+    }
+    
+    [self setValue:[NSString stringWithFormat:@"%@ %lu", PMBenchmarkObjectWords[seed % PMBenchmarkObjectWordCount], (unsigned long)seed] forKey:mjz_key(title)];
+    [self setValue:payload forKey:mjz_key(payload)];
+    [self setValue:[NSURL URLWithString:[NSString stringWithFormat:@"https://www.example.com/users/%lu/avatar.png", (unsigned long)seed]] forKey:mjz_key(url)];
+    [self setValue:@[PMBenchmarkObjectWords[seed % 5], PMBenchmarkObjectWords[seed % 7], PMBenchmarkObjectWords[seed % 11]] forKey:mjz_key(tags)];
+    [self setValue:@(seed) forKey:mjz_key(counter)];
+    [self setValue:@(seed / 3.0) forKey:mjz_key(score)];
+}
+
+@end
@@ -0,0 +1,55 @@
+//
+//  PMStoreConformance.h
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import <Foundation/Foundation.h>
+
+@class PMPersistentStore;
+
+/**
+ * Checks that a persistent store follows the `PMPersistentStore` specifications.
+ *
+ * The same checks are run against every store: objects are created, read, queried, updated and deleted, and stores with a file are reopened to check what was saved.
+ **/
+@interface PMStoreConformance : NSObject
+
+/**
+ * Default initializer.
+ * @param name The name of the checked store.
+ * @param storeBlock Returns a new store. Called again to reopen the store: it must return a store with the same file, if any.
+ * @param reopens YES if saved objects must be found in a reopened store, NO for stores without file.
+ **/
+- (id)initWithName:(NSString*)name storeBlock:(PMPersistentStore *(^)())storeBlock reopens:(BOOL)reopens;
+
+/**
+ * The name of the checked store.
+ **/
+@property (nonatomic, strong, readonly) NSString *name;
+
+/**
+ * Runs all checks.
+ * @return An array with the description of every failed check. Empty if the store conforms.
+ **/
+- (NSArray*)run;
+
+@end
@@ -0,0 +1,257 @@
+//
+//  PMStoreConformance.m
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import "PMStoreConformance.h"
+
+#import "PMPersistentStore.h"
+#import "PMPersistentObject.h"
+
+static NSString * const PMStoreConformanceType = @"PMConformanceObject";
+static NSString * const PMStoreConformanceOtherType = @"PMConformanceOtherObject";
+
+/**
+ * Number of objects of the main type created by the checks.
+ **/
+static NSUInteger const PMStoreConformanceCount = 20;
+
+@implementation PMStoreConformance
+{
+    PMPersistentStore *(^_storeBlock)();
+    BOOL _reopens;
+    NSDate *_baseDate;
+    NSMutableArray *_failures;
+}
+
+- (id)initWithName:(NSString*)name storeBlock:(PMPersistentStore *(^)())storeBlock reopens:(BOOL)reopens
+{
+    self = [super init];
+    if (self)
+    {
+        _name = name;
+        _storeBlock = [storeBlock copy];
+        _reopens = reopens;
+        _baseDate = [NSDate dateWithTimeIntervalSince1970:1000000000];
+        _failures = [NSMutableArray array];
+    }
+    return self;
+}
+
+#pragma mark Public Methods
+
+- (NSArray*)run
+{
+    [_failures removeAllObjects];
+    
+    PMPersistentStore *store = _storeBlock();
+    
+    @try
+    {
+        [self pmd_checkCreatingInStore:store];
+        [self pmd_checkReadingInStore:store];
+        [self pmd_checkQueryingInStore:store];
+        [self pmd_checkMetadataInStore:store];
+        [self pmd_checkUpdatingInStore:store];
+        
+        if (_reopens)
+        {
+            store = nil;
+            store = _storeBlock();
+            [self pmd_checkReopenedStore:store];
+        }
+        
+        [self pmd_checkDeletingInStore:store];
+    }
+    @catch (NSException *exception)
+    {
+        [self pmd_check:NO description:[NSString stringWithFormat:@"unexpected exception: %@", exception.reason]];
+    }
+    
+    return [_failures copy];
+}
+
+#pragma mark Private Methods
+
+- (void)pmd_check:(BOOL)condition description:(NSString*)description
+{
+    if (!condition)
+        [_failures addObject:description];
+}
+
+- (NSString*)pmd_keyAtIndex:(NSUInteger)index
+{
+    return [NSString stringWithFormat:@"key-%04lu", (unsigned long)index];
+}
+
+- (NSData*)pmd_dataAtIndex:(NSUInteger)index
+{
+    return [[NSString stringWithFormat:@"data-%lu", (unsigned long)index] dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+- (NSDate*)pmd_dateAtIndex:(NSUInteger)index
+{
+    // Keys and update dates are in opposite orders, so both orders can be checked.
+    return [_baseDate dateByAddingTimeInterval:PMStoreConformanceCount - index];
+}
+
+- (BOOL)pmd_isDate:(NSDate*)date equalToDate:(NSDate*)otherDate
+{
+    return fabs(date.timeIntervalSince1970 - otherDate.timeIntervalSince1970) < 1e-3;
+}
+
+- (void)pmd_checkCreatingInStore:(PMPersistentStore*)store
+{
+    for (NSUInteger index = 0; index < PMStoreConformanceCount; ++index)
+    {
+        id<PMPersistentObject> object = [store createPersistentObjectWithKey:[self pmd_keyAtIndex:index] ofType:PMStoreConformanceType];
+        object.lastUpdate = [self pmd_dateAtIndex:index];
+        object.data = [self pmd_dataAtIndex:index];
+    }
+    
+    id<PMPersistentObject> other = [store createPersistentObjectWithKey:@"other" ofType:PMStoreConformanceOtherType];
+    other.lastUpdate = _baseDate;
+    other.data = [self pmd_dataAtIndex:0];
+    
+    [self pmd_check:[store save] description:@"save: creations are not saved"];
+    
+    BOOL raises = NO;
+    
+    @try
+    {
+        [store createPersistentObjectWithKey:[self pmd_keyAtIndex:0] ofType:PMStoreConformanceType];
+    }
+    @catch (NSException *exception)
+    {
+        raises = [exception.name isEqualToString:NSInvalidArgumentException];
+    }
+    
+    [self pmd_check:raises description:@"createPersistentObjectWithKey:ofType: doesn't raise a NSInvalidArgumentException for an existing key"];
+}
+
+- (void)pmd_checkReadingInStore:(PMPersistentStore*)store
+{
+    id<PMPersistentObject> object = [store persistentObjectWithKey:[self pmd_keyAtIndex:3]];
+    
+    [self pmd_check:[object.key isEqualToString:[self pmd_keyAtIndex:3]] description:@"persistentObjectWithKey: returns a wrong key"];
+    [self pmd_check:[object.type isEqualToString:PMStoreConformanceType] description:@"persistentObjectWithKey: returns a wrong type"];
+    [self pmd_check:[object.data isEqualToData:[self pmd_dataAtIndex:3]] description:@"persistentObjectWithKey: returns wrong data"];
+    [self pmd_check:[self pmd_isDate:object.lastUpdate equalToDate:[self pmd_dateAtIndex:3]] description:@"persistentObjectWithKey: returns a wrong last update"];
+    [self pmd_check:[store persistentObjectWithKey:@"missing"] == nil description:@"persistentObjectWithKey: returns an object for a missing key"];
+    
+    NSArray *objects = [store persistentObjectsWithKeys:@[[self pmd_keyAtIndex:1], @"missing", [self pmd_keyAtIndex:2]]];
+    NSSet *keys = [NSSet setWithArray:[objects valueForKey:@"key"]];
+    
+    [self pmd_check:[keys isEqualToSet:[NSSet setWithObjects:[self pmd_keyAtIndex:1], [self pmd_keyAtIndex:2], nil]] description:@"persistentObjectsWithKeys: doesn't return only the found objects"];
+}
+
+- (void)pmd_checkQueryingInStore:(PMPersistentStore*)store
+{
+    NSArray *objects = [store persistentObjectsOfType:PMStoreConformanceType];
+    
+    [self pmd_check:objects.count == PMStoreConformanceCount description:@"persistentObjectsOfType: returns a wrong number of objects"];
+    [self pmd_check:![[objects valueForKey:@"key"] containsObject:@"other"] description:@"persistentObjectsOfType: returns objects of another type"];
+    
+    objects = [store persistentObjectsOfType:PMStoreConformanceType includesData:NO];
+    
+    [self pmd_check:objects.count == PMStoreConformanceCount description:@"persistentObjectsOfType:includesData: returns a wrong number of objects"];
+    
+    objects = [store persistentObjectsOfType:PMStoreConformanceType offset:2 limit:3 order:PMOptionOrderByKey];
+    
+    [self pmd_check:[[objects valueForKey:@"key"] isEqualToArray:@[[self pmd_keyAtIndex:2], [self pmd_keyAtIndex:3], [self pmd_keyAtIndex:4]]]
+        description:@"persistentObjectsOfType:offset:limit:order: returns a wrong page by key"];
+    
+    objects = [store persistentObjectsOfType:PMStoreConformanceType offset:0 limit:2 order:PMOptionOrderByUpdateDate];
+    
+    [self pmd_check:[[objects valueForKey:@"key"] isEqualToArray:@[[self pmd_keyAtIndex:PMStoreConformanceCount - 1], [self pmd_keyAtIndex:PMStoreConformanceCount - 2]]]
+        description:@"persistentObjectsOfType:offset:limit:order: returns a wrong page by update date"];
+    
+    objects = [store persistentObjectsOfType:PMStoreConformanceType afterKey:[self pmd_keyAtIndex:17] limit:5];
+    
+    [self pmd_check:[[objects valueForKey:@"key"] isEqualToArray:@[[self pmd_keyAtIndex:18], [self pmd_keyAtIndex:19]]]
+        description:@"persistentObjectsOfType:afterKey:limit: returns wrong objects"];
+    
+    objects = [store persistentObjectsOfType:PMStoreConformanceType afterKey:nil limit:1];
+    
+    [self pmd_check:[[objects valueForKey:@"key"] isEqualToArray:@[[self pmd_keyAtIndex:0]]]
+        description:@"persistentObjectsOfType:afterKey:limit: doesn't start from the first key"];
+}
+
+- (void)pmd_checkMetadataInStore:(PMPersistentStore*)store
+{
+    [self pmd_check:[store countOfObjectsOfType:PMStoreConformanceType] == PMStoreConformanceCount description:@"countOfObjectsOfType: returns a wrong count"];
+    [self pmd_check:[store countOfObjectsOfType:@"missing"] == 0 description:@"countOfObjectsOfType: counts objects of a missing type"];
+    
+    // Dates of the objects at index 0 to 4 are equal or later than the date of the object at index 4.
+    NSSet *keys = [NSSet setWithArray:[store keysOfType:PMStoreConformanceType updatedSince:[self pmd_dateAtIndex:4]]];
+    NSMutableSet *expectedKeys = [NSMutableSet set];
+    
+    for (NSUInteger index = 0; index <= 4; ++index)
+        [expectedKeys addObject:[self pmd_keyAtIndex:index]];
+    
+    [self pmd_check:[keys isEqualToSet:expectedKeys] description:@"keysOfType:updatedSince: returns wrong keys"];
+    [self pmd_check:[store keysOfType:PMStoreConformanceType updatedSince:nil].count == PMStoreConformanceCount description:@"keysOfType:updatedSince: doesn't return all keys without date"];
+    
+    [self pmd_check:[self pmd_isDate:[store lastUpdateForKey:[self pmd_keyAtIndex:5]] equalToDate:[self pmd_dateAtIndex:5]] description:@"lastUpdateForKey: returns a wrong date"];
+    [self pmd_check:[store lastUpdateForKey:@"missing"] == nil description:@"lastUpdateForKey: returns a date for a missing key"];
+}
+
+- (void)pmd_checkUpdatingInStore:(PMPersistentStore*)store
+{
+    id<PMPersistentObject> object = [store persistentObjectWithKey:[self pmd_keyAtIndex:0]];
+    object.data = [self pmd_dataAtIndex:100];
+    object.lastUpdate = [_baseDate dateByAddingTimeInterval:100];
+    
+    [self pmd_check:[store save] description:@"save: updates are not saved"];
+    
+    object = [store persistentObjectWithKey:[self pmd_keyAtIndex:0]];
+    
+    [self pmd_check:[object.data isEqualToData:[self pmd_dataAtIndex:100]] description:@"persistentObjectWithKey: doesn't return updated data"];
+    [self pmd_check:[self pmd_isDate:[store lastUpdateForKey:[self pmd_keyAtIndex:0]] equalToDate:[_baseDate dateByAddingTimeInterval:100]] description:@"lastUpdateForKey: doesn't return the updated date"];
+}
+
+- (void)pmd_checkReopenedStore:(PMPersistentStore*)store
+{
+    [self pmd_check:[store countOfObjectsOfType:PMStoreConformanceType] == PMStoreConformanceCount description:@"reopened store: saved objects are missing"];
+    [self pmd_check:[[store persistentObjectWithKey:[self pmd_keyAtIndex:0]].data isEqualToData:[self pmd_dataAtIndex:100]] description:@"reopened store: updated data is missing"];
+    [self pmd_check:[[store persistentObjectWithKey:[self pmd_keyAtIndex:7]].data isEqualToData:[self pmd_dataAtIndex:7]] description:@"reopened store: created data is missing"];
+}
+
+- (void)pmd_checkDeletingInStore:(PMPersistentStore*)store
+{
+    [store deletePersistentObjectWithKey:[self pmd_keyAtIndex:1]];
+    
+    [self pmd_check:[store save] description:@"save: deletions are not saved"];
+    [self pmd_check:[store persistentObjectWithKey:[self pmd_keyAtIndex:1]] == nil description:@"persistentObjectWithKey: returns a deleted object"];
+    [self pmd_check:[store countOfObjectsOfType:PMStoreConformanceType] == PMStoreConformanceCount - 1 description:@"countOfObjectsOfType: counts a deleted object"];
+    
+    // Objects at index 11 to 19 were updated before the object at index 10.
+    BOOL succeed = [store deleteEntriesOfType:PMStoreConformanceType olderThan:[self pmd_dateAtIndex:10] policy:PMOptionDeleteByUpdateDate];
+    [store save];
+    
+    [self pmd_check:succeed description:@"deleteEntriesOfType:olderThan:policy: fails"];
+    [self pmd_check:[store persistentObjectWithKey:[self pmd_keyAtIndex:15]] == nil description:@"deleteEntriesOfType:olderThan:policy: doesn't delete older objects"];
+    [self pmd_check:[store persistentObjectWithKey:[self pmd_keyAtIndex:5]] != nil description:@"deleteEntriesOfType:olderThan:policy: deletes newer objects"];
+    [self pmd_check:[store persistentObjectWithKey:@"other"] != nil description:@"deleteEntriesOfType:olderThan:policy: deletes objects of another type"];
+}
+
+@end
@@ -0,0 +1,79 @@
+//
+//  conformance.m
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import <Foundation/Foundation.h>
+
+#import "PMSQLiteStore.h"
+#import "PMShardedSQLiteStore.h"
+#import "PMLogStore.h"
+#import "PMMemoryStore.h"
+
+#import "PMStoreConformance.h"
+
+/**
+ * Runs the store conformance checks against every store. Exits with a non zero status if any check fails.
+ * Options, read from the command line arguments: -directory (where store files are created).
+ **/
+int main(int argc, const char * argv[])
+{
+    @autoreleasepool
+    {
+        NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+        [defaults registerDefaults:@{@"directory" : [NSTemporaryDirectory() stringByAppendingPathComponent:@"PMStoreConformance"]}];
+        
+        NSString *directory = [defaults stringForKey:@"directory"];
+        
+        NSFileManager *fileManager = [NSFileManager defaultManager];
+        [fileManager removeItemAtPath:directory error:nil];
+        [fileManager createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:nil];
+        
+        NSURL *sqliteURL = [NSURL fileURLWithPath:[directory stringByAppendingPathComponent:@"store.sqlite"]];
+        NSURL *shardedURL = [NSURL fileURLWithPath:[directory stringByAppendingPathComponent:@"store.shards"] isDirectory:YES];
+        NSURL *logURL = [NSURL fileURLWithPath:[directory stringByAppendingPathComponent:@"store.log"]];
+        NSURL *memoryURL = [NSURL fileURLWithPath:[directory stringByAppendingPathComponent:@"store.snapshot"]];
+        
+        NSArray *conformances = @[[[PMStoreConformance alloc] initWithName:@"PMSQLiteStore" storeBlock:^PMPersistentStore *{ return [[PMSQLiteStore alloc] initWithURL:sqliteURL]; } reopens:YES],
+                                  [[PMStoreConformance alloc] initWithName:@"PMSQLiteStore (readers)" storeBlock:^PMPersistentStore *{ return [[PMSQLiteStore alloc] initWithURL:[sqliteURL URLByAppendingPathExtension:@"readers"] maximumConcurrentReaders:2]; } reopens:YES],
+                                  [[PMStoreConformance alloc] initWithName:@"PMShardedSQLiteStore" storeBlock:^PMPersistentStore *{ return [[PMShardedSQLiteStore alloc] initWithURL:shardedURL shardCount:3]; } reopens:YES],
+                                  [[PMStoreConformance alloc] initWithName:@"PMLogStore" storeBlock:^PMPersistentStore *{ return [[PMLogStore alloc] initWithURL:logURL]; } reopens:YES],
+                                  [[PMStoreConformance alloc] initWithName:@"PMMemoryStore" storeBlock:^PMPersistentStore *{ return [[PMMemoryStore alloc] initWithURL:memoryURL]; } reopens:YES],
+                                  [[PMStoreConformance alloc] initWithName:@"PMMemoryStore (no file)" storeBlock:^PMPersistentStore *{ return [[PMMemoryStore alloc] init]; } reopens:NO],
+                                  ];
+        
+        NSUInteger failureCount = 0;
+        
+        for (PMStoreConformance *conformance in conformances)
+        {
+            NSArray *failures = [conformance run];
+            failureCount += failures.count;
+            
+            fprintf(stderr, "%-24s %s\n", conformance.name.UTF8String, failures.count == 0 ? "passed" : "FAILED");
+            
+            for (NSString *failure in failures)
+                fprintf(stderr, "    %s\n", failure.UTF8String);
+        }
+        
+        return failureCount == 0 ? 0 : 1;
+    }
+}
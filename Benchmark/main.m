@@ -0,0 +1,736 @@
+//
+//  main.m
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import <Foundation/Foundation.h>
+
+#import "PMObjectContext.h"
+#import "PMPersistentObject.h"
+#import "PMSQLiteStore.h"
+#import "PMBinaryCodec.h"
+
+#import "PMBenchmark.h"
+#import "PMBenchmarkObject.h"
+#import "PMUser.h"
+#import "PMVideo.h"
+
+/**
+ * Options, read from the command line arguments (ie. `-count 10000`).
+ **/
+static NSString * const PMBenchmarkCountOption = @"count";
+static NSString * const PMBenchmarkPayloadSizeOption = @"payloadSize";
+static NSString * const PMBenchmarkBatchSizeOption = @"batchSize";
+static NSString * const PMBenchmarkLookupsOption = @"lookups";
+static NSString * const PMBenchmarkRoundsOption = @"rounds";
+static NSString * const PMBenchmarkWorkloadsOption = @"workloads";
+static NSString * const PMBenchmarkDirectoryOption = @"directory";
+static NSString * const PMBenchmarkOutputOption = @"output";
+static NSString * const PMBenchmarkIsolateOption = @"isolate";
+static NSString * const PMBenchmarkPopulateOption = @"populate";
+
+static NSUInteger count;
+static NSUInteger payloadSize;
+static NSUInteger batchSize;
+static NSUInteger lookups;
+static NSUInteger rounds;
+static NSString *directory;
+
+#pragma mark Helpers
+
+static NSURL *storeURL(NSString *name)
+{
+    NSString *path = [directory stringByAppendingPathComponent:[name stringByAppendingPathExtension:@"sqlite"]];
+    
+    for (NSString *suffix in @[@"", @"-wal", @"-shm"])
+        [[NSFileManager defaultManager] removeItemAtPath:[path stringByAppendingString:suffix] error:nil];
+    
+    return [NSURL fileURLWithPath:path];
+}
+
+static unsigned long long fileSize(NSURL *url)
+{
+    return [[[NSFileManager defaultManager] attributesOfItemAtPath:url.path error:nil] fileSize];
+}
+
+static NSString *keyAtIndex(NSUInteger index)
+{
+    return [NSString stringWithFormat:@"object-%08lu", (unsigned long)index];
+}
+
+static NSUInteger randomIndex(NSUInteger *state, NSUInteger limit)
+{
+    // Deterministic, so runs are comparable.
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (NSUInteger)((*state >> 33) % limit);
+}
+
+static BOOL saveAndWait(PMObjectContext *context)
+{
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    __block BOOL succeed = NO;
+    
+    [context saveWithCompletionBlock:^(BOOL result) {
+        succeed = result;
+        dispatch_semaphore_signal(semaphore);
+    }];
+    
+    dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+    
+    return succeed;
+}
+
+static void insertObjects(PMObjectContext *context, NSUInteger start, NSUInteger end)
+{
+    for (NSUInteger index = start; index < end; ++index)
+    {
+        PMBenchmarkObject *object = [[PMBenchmarkObject alloc] initWithKey:keyAtIndex(index) context:context];
+        [object fillWithSeed:index payloadSize:payloadSize];
+        object.lastUpdate = [NSDate date];
+    }
+}
+
+static NSURL *mainStoreURL()
+{
+    return [NSURL fileURLWithPath:[directory stringByAppendingPathComponent:@"main.sqlite"]];
+}
+
+static NSString *compressionBenchmarkName(NSInteger threshold)
+{
+    return threshold < 0 ? @"compression-none" : [NSString stringWithFormat:@"compression-%ld", (long)threshold];
+}
+
+static PMSQLiteStore *populatedStore()
+{
+    NSURL *url = storeURL(@"main");
+    PMSQLiteStore *store = [[PMSQLiteStore alloc] initWithURL:url];
+    
+    for (NSUInteger start = 0; start < count; start += batchSize)
+    {
+        @autoreleasepool
+        {
+            PMObjectContext *context = [[PMObjectContext alloc] initWithPersistentStore:store];
+            insertObjects(context, start, MIN(start + batchSize, count));
+            saveAndWait(context);
+        }
+    }
+    
+    return store;
+}
+
+#pragma mark Workloads
+
+static PMBenchmark *insertBenchmark()
+{
+    PMBenchmark *benchmark = [[PMBenchmark alloc] initWithName:@"insert"];
+    PMSQLiteStore *store = [[PMSQLiteStore alloc] initWithURL:storeURL(@"insert")];
+    PMObjectContext *context = [[PMObjectContext alloc] initWithPersistentStore:store];
+    context.retainsRegisteredObjects = NO;
+    
+    for (NSUInteger start = 0; start < count; start += batchSize)
+    {
+        NSUInteger end = MIN(start + batchSize, count);
+        
+        [benchmark measureOperations:end - start usingBlock:^{
+            insertObjects(context, start, end);
+            saveAndWait(context);
+        }];
+    }
+    
+    return benchmark;
+}
+
+static PMBenchmark *insertModelsBenchmark()
+{
+    PMBenchmark *benchmark = [[PMBenchmark alloc] initWithName:@"insert-models"];
+    PMSQLiteStore *store = [[PMSQLiteStore alloc] initWithURL:storeURL(@"insert-models")];
+    PMObjectContext *context = [[PMObjectContext alloc] initWithPersistentStore:store];
+    context.retainsRegisteredObjects = NO;
+    
+    for (NSUInteger start = 0; start < count; start += batchSize)
+    {
+        NSUInteger end = MIN(start + batchSize, count);
+        
+        [benchmark measureOperations:end - start usingBlock:^{
+            for (NSUInteger index = start; index < end; ++index)
+            {
+                NSString *userKey = [NSString stringWithFormat:@"user-%lu", (unsigned long)index];
+                
+                // Half users, half videos uploaded by the previous user.
+                if (index % 2 == 0)
+                {
+                    PMUser *user = [[PMUser alloc] initWithKey:userKey context:context];
+                    [user setValue:[NSString stringWithFormat:@"user.%lu", (unsigned long)index] forKey:@"username"];
+                    [user setValue:@(18 + index % 60) forKey:@"age"];
+                    [user setValue:[NSURL URLWithString:[NSString stringWithFormat:@"https://www.example.com/%lu.png", (unsigned long)index]] forKey:@"avatarURL"];
+                }
+                else
+                {
+                    PMVideo *video = [[PMVideo alloc] initWithKey:[NSString stringWithFormat:@"video-%lu", (unsigned long)index] context:context];
+                    [video setValue:[NSString stringWithFormat:@"Video %lu", (unsigned long)index] forKey:@"title"];
+                    [video setValue:@"A video uploaded to the benchmark." forKey:@"about"];
+                    [video setValue:@(index * 7) forKey:@"likesCount"];
+                    [video setValue:@(index * 31) forKey:@"viewsCount"];
+                    [video setValue:[NSString stringWithFormat:@"user-%lu", (unsigned long)index - 1] forKey:@"uploaderKey"];
+                    [video setValue:@[userKey] forKey:@"participantsKeys"];
+                }
+            }
+            
+            saveAndWait(context);
+        }];
+    }
+    
+    return benchmark;
+}
+
+static PMBenchmark *importBenchmark()
+{
+    PMBenchmark *benchmark = [[PMBenchmark alloc] initWithName:@"import"];
+    PMSQLiteStore *store = [[PMSQLiteStore alloc] initWithURL:storeURL(@"import")];
+    PMObjectContext *context = [[PMObjectContext alloc] initWithPersistentStore:store];
+    context.retainsRegisteredObjects = NO;
+    
+    NSString *payload = [@"" stringByPaddingToLength:payloadSize withString:@"lorem ipsum " startingAtIndex:0];
+    
+    // Dictionaries as parsed from a server: numeric keys, fields without property and nulls, also for scalar properties.
+    NSMutableArray *dictionaries = [NSMutableArray arrayWithCapacity:count];
+    
+    for (NSUInteger index = 0; index < count; ++index)
+    {
+        [dictionaries addObject:@{@"id" : @(index),
+                                  @"title" : index % 10 == 0 ? [NSNull null] : [NSString stringWithFormat:@"Object %lu", (unsigned long)index],
+                                  @"payload" : payload,
+                                  @"counter" : index % 10 == 1 ? [NSNull null] : @(index),
+                                  @"score" : @(index * 0.5),
+                                  @"etag" : [NSString stringWithFormat:@"%08lx", (unsigned long)index],
+                                  }];
+    }
+    
+    __block BOOL succeed = NO;
+    
+    [benchmark measureOperations:count usingBlock:^{
+        succeed = [context importObjectsOfClass:PMBenchmarkObject.class fromDictionaries:dictionaries keyAttribute:@"id" batchSize:batchSize];
+    }];
+    
+    NSUInteger importedCount = [context countOfObjectsOfClass:PMBenchmarkObject.class];
+    
+    [benchmark setMetric:@(succeed) forKey:@"succeed"];
+    [benchmark setMetric:@(importedCount) forKey:@"imported"];
+    
+    if (!succeed || importedCount != count)
+        fprintf(stderr, "import: %lu of %lu objects imported\n", (unsigned long)importedCount, (unsigned long)count);
+    
+    return benchmark;
+}
+
+static PMBenchmark *lookupBenchmark(PMSQLiteStore *store, BOOL hot)
+{
+    PMBenchmark *benchmark = [[PMBenchmark alloc] initWithName:hot ? @"lookup-hot" : @"lookup-cold"];
+    
+    PMObjectContext *context = [[PMObjectContext alloc] initWithPersistentStore:store];
+    
+    if (hot)
+        [context objectsOfClass:PMBenchmarkObject.class];
+    else
+        [store cleanCache];
+    
+    NSUInteger state = 1;
+    
+    for (NSUInteger lookup = 0; lookup < lookups; ++lookup)
+    {
+        // Cold lookups use a new context, so objects are always read from the database.
+        if (!hot && lookup % batchSize == 0)
+        {
+            context = [[PMObjectContext alloc] initWithPersistentStore:store];
+            [store cleanCache];
+        }
+        
+        NSString *key = keyAtIndex(randomIndex(&state, count));
+        
+        [benchmark measureOperations:1 usingBlock:^{
+            [context objectForKey:key];
+        }];
+    }
+    
+    return benchmark;
+}
+
+static PMBenchmark *scanBenchmark(PMSQLiteStore *store)
+{
+    PMBenchmark *benchmark = [[PMBenchmark alloc] initWithName:@"scan"];
+    
+    for (NSUInteger round = 0; round < rounds; ++round)
+    {
+        [store cleanCache];
+        PMObjectContext *context = [[PMObjectContext alloc] initWithPersistentStore:store];
+        
+        [benchmark measureOperations:count usingBlock:^{
+            [context objectsOfClass:PMBenchmarkObject.class];
+        }];
+    }
+    
+    return benchmark;
+}
+
+static PMBenchmark *updateBenchmark(PMSQLiteStore *store)
+{
+    PMBenchmark *benchmark = [[PMBenchmark alloc] initWithName:@"update"];
+    
+    PMObjectContext *context = [[PMObjectContext alloc] initWithPersistentStore:store];
+    NSArray *objects = [context objectsOfClass:PMBenchmarkObject.class];
+    
+    NSUInteger updates = MAX(objects.count / 10, 1);
+    NSUInteger state = 2;
+    
+    for (NSUInteger round = 0; round < rounds; ++round)
+    {
+        [benchmark measureOperations:updates usingBlock:^{
+            NSUInteger seed = state;
+            
+            for (NSUInteger update = 0; update < updates; ++update)
+            {
+                PMBenchmarkObject *object = objects[randomIndex(&seed, objects.count)];
+                [object setValue:@(object.counter + 1) forKey:mjz_key(counter)];
+                object.lastUpdate = [NSDate date];
+            }
+            
+            saveAndWait(context);
+        }];
+        
+        randomIndex(&state, count);
+    }
+    
+    return benchmark;
+}
+
+static PMBenchmark *purgeBenchmark()
+{
+    PMBenchmark *benchmark = [[PMBenchmark alloc] initWithName:@"purge"];
+    PMSQLiteStore *store = [[PMSQLiteStore alloc] initWithURL:storeURL(@"purge")];
+    
+    NSUInteger roundCount = MAX(count / rounds, 1);
+    
+    for (NSUInteger round = 0; round < rounds; ++round)
+    {
+        @autoreleasepool
+        {
+            PMObjectContext *context = [[PMObjectContext alloc] initWithPersistentStore:store];
+            insertObjects(context, 0, roundCount);
+            saveAndWait(context);
+        }
+        
+        [benchmark measureOperations:roundCount usingBlock:^{
+            [store deleteEntriesOfType:NSStringFromClass(PMBenchmarkObject.class) olderThan:[NSDate distantFuture] policy:PMOptionDeleteByCreationDate];
+        }];
+    }
+    
+    return benchmark;
+}
+
+static PMBenchmark *mergeBenchmark(PMSQLiteStore *store)
+{
+    PMBenchmark *benchmark = [[PMBenchmark alloc] initWithName:@"merge"];
+    
+    PMObjectContext *context = [[PMObjectContext alloc] initWithPersistentStore:store];
+    PMObjectContext *otherContext = [[PMObjectContext alloc] initWithPersistentStore:store];
+    
+    NSArray *objects = [context objectsOfClass:PMBenchmarkObject.class];
+    [otherContext objectsOfClass:PMBenchmarkObject.class];
+    
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    
+    id observer = [[NSNotificationCenter defaultCenter] addObserverForName:PMObjectContextDidSaveNotification object:context queue:nil usingBlock:^(NSNotification *notification) {
+        [otherContext mergeChangesFromContextDidSaveNotification:notification];
+        
+        // Merges are queued in the context queue: this block runs after it.
+        [otherContext performBlock:^{
+            dispatch_semaphore_signal(semaphore);
+        }];
+    }];
+    
+    NSUInteger updates = MAX(objects.count / 10, 1);
+    NSUInteger state = 3;
+    
+    for (NSUInteger round = 0; round < rounds; ++round)
+    {
+        [benchmark measureOperations:updates usingBlock:^{
+            NSUInteger seed = state;
+            
+            for (NSUInteger update = 0; update < updates; ++update)
+            {
+                PMBenchmarkObject *object = objects[randomIndex(&seed, objects.count)];
+                [object setValue:@(object.counter + 1) forKey:mjz_key(counter)];
+            }
+            
+            saveAndWait(context);
+            dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+        }];
+        
+        randomIndex(&state, count);
+    }
+    
+    [[NSNotificationCenter defaultCenter] removeObserver:observer];
+    
+    return benchmark;
+}
+
+static PMBenchmark *decodeScalingBenchmark(PMSQLiteStore *store, NSUInteger workers)
+{
+    PMBenchmark *benchmark = [[PMBenchmark alloc] initWithName:[NSString stringWithFormat:@"decode-scaling-%lu", (unsigned long)workers]];
+    
+    // Data is read once: only the codec is measured, serially and with the given number of workers.
+    NSArray *data = [[store persistentObjectsOfType:NSStringFromClass(PMBenchmarkObject.class)] valueForKey:@"data"];
+    NSUInteger objectCount = data.count;
+    PMBinaryCodec *codec = [PMBinaryCodec defaultCodec];
+    
+    void (^decode)(NSUInteger, NSUInteger) = ^(NSUInteger worker, NSUInteger workerCount) {
+        for (NSUInteger index = worker; index < objectCount; index += workerCount)
+        {
+            @autoreleasepool
+            {
+                [codec objectOfClass:PMBenchmarkObject.class withData:data[index]];
+            }
+        }
+    };
+    
+    NSTimeInterval serialStart = PMBenchmarkNow();
+    
+    for (NSUInteger round = 0; round < rounds; ++round)
+        decode(0, 1);
+    
+    NSTimeInterval serialTime = (PMBenchmarkNow() - serialStart) / rounds;
+    
+    for (NSUInteger round = 0; round < rounds; ++round)
+    {
+        [benchmark measureOperations:objectCount usingBlock:^{
+            dispatch_apply(workers, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t worker) {
+                decode(worker, workers);
+            });
+        }];
+    }
+    
+    NSTimeInterval concurrentTime = [[benchmark dictionaryRepresentation][@"seconds"] doubleValue] / rounds;
+    
+    [benchmark setMetric:@(workers) forKey:@"workers"];
+    [benchmark setMetric:@(serialTime) forKey:@"serial_seconds"];
+    [benchmark setMetric:@(concurrentTime) forKey:@"concurrent_seconds"];
+    [benchmark setMetric:@(concurrentTime > 0 ? serialTime / concurrentTime : 0) forKey:@"speedup"];
+    
+    return benchmark;
+}
+
+static PMBenchmark *concurrentReadsBenchmark(NSUInteger readers)
+{
+    NSString *name = readers > 0 ? [NSString stringWithFormat:@"concurrent-reads-%lu", (unsigned long)readers] : @"concurrent-reads-single";
+    PMBenchmark *benchmark = [[PMBenchmark alloc] initWithName:name];
+    
+    // Reuses the database of the main store.
+    PMSQLiteStore *store = [[PMSQLiteStore alloc] initWithURL:mainStoreURL() maximumConcurrentReaders:readers];
+    store.cacheCountLimit = 1;
+    
+    // A writer saves updates to the same store while the readers run.
+    __block volatile BOOL isWriting = YES;
+    __block NSUInteger writes = 0;
+    
+    dispatch_group_t writerGroup = dispatch_group_create();
+    
+    dispatch_group_async(writerGroup, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0), ^{
+        PMObjectContext *context = [[PMObjectContext alloc] initWithPersistentStore:store];
+        context.retainsRegisteredObjects = NO;
+        
+        NSUInteger state = 5;
+        
+        while (isWriting)
+        {
+            @autoreleasepool
+            {
+                for (NSUInteger update = 0; update < 10; ++update)
+                {
+                    PMBenchmarkObject *object = (PMBenchmarkObject*)[context objectForKey:keyAtIndex(randomIndex(&state, count))];
+                    [object setValue:@(object.counter + 1) forKey:mjz_key(counter)];
+                }
+                
+                if (saveAndWait(context))
+                    writes += 10;
+            }
+        }
+    });
+    
+    [benchmark measureWallClockUsingBlock:^{
+        dispatch_apply(lookups, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t lookup) {
+            NSUInteger state = lookup + 1;
+            NSString *key = keyAtIndex(randomIndex(&state, count));
+            
+            [benchmark measureOperations:1 usingBlock:^{
+                [store persistentObjectWithKey:key];
+            }];
+        });
+    }];
+    
+    isWriting = NO;
+    dispatch_group_wait(writerGroup, DISPATCH_TIME_FOREVER);
+    
+    NSTimeInterval time = [[benchmark dictionaryRepresentation][@"seconds"] doubleValue];
+    
+    [benchmark setMetric:@(readers) forKey:@"readers"];
+    [benchmark setMetric:@(writes) forKey:@"concurrent_writes"];
+    [benchmark setMetric:@(time > 0 ? writes / time : 0) forKey:@"write_throughput"];
+    
+    return benchmark;
+}
+
+static PMBenchmark *compressionBenchmark(NSInteger threshold)
+{
+    NSString *name = compressionBenchmarkName(threshold);
+    PMBenchmark *benchmark = [[PMBenchmark alloc] initWithName:name];
+    
+    NSURL *url = storeURL(name);
+    PMSQLiteStore *store = [[PMSQLiteStore alloc] initWithURL:url];
+    store.compressesData = threshold >= 0;
+    store.compressionThreshold = MAX(threshold, 0);
+    
+    NSTimeInterval writeStart = PMBenchmarkNow();
+    
+    for (NSUInteger start = 0; start < count; start += batchSize)
+    {
+        @autoreleasepool
+        {
+            PMObjectContext *context = [[PMObjectContext alloc] initWithPersistentStore:store];
+            insertObjects(context, start, MIN(start + batchSize, count));
+            saveAndWait(context);
+        }
+    }
+    
+    NSTimeInterval writeTime = PMBenchmarkNow() - writeStart;
+    
+    // Reads are measured as cold point lookups.
+    NSUInteger state = 4;
+    
+    for (NSUInteger lookup = 0; lookup < lookups; ++lookup)
+    {
+        if (lookup % batchSize == 0)
+            [store cleanCache];
+        
+        NSString *key = keyAtIndex(randomIndex(&state, count));
+        
+        [benchmark measureOperations:1 usingBlock:^{
+            [store persistentObjectWithKey:key];
+        }];
+    }
+    
+    unsigned long long size = fileSize(url);
+    
+    [benchmark setMetric:@(threshold) forKey:@"threshold"];
+    [benchmark setMetric:@(size) forKey:@"file_bytes"];
+    [benchmark setMetric:@(writeTime > 0 ? count / writeTime : 0) forKey:@"write_throughput"];
+    
+    // Compared with the store written without compression by a previous workload.
+    unsigned long long uncompressedSize = fileSize([NSURL fileURLWithPath:[directory stringByAppendingPathComponent:[compressionBenchmarkName(-1) stringByAppendingPathExtension:@"sqlite"]]]);
+    
+    if (uncompressedSize > 0)
+        [benchmark setMetric:@((double)size / uncompressedSize) forKey:@"size_ratio"];
+    
+    return benchmark;
+}
+
+#pragma mark Running
+
+/**
+ * Runs a single benchmark in a new process of this tool, so its peak resident size is its own.
+ **/
+static NSArray *isolatedResults(NSString *name)
+{
+    NSString *output = [directory stringByAppendingPathComponent:[name stringByAppendingPathExtension:@"json"]];
+    [[NSFileManager defaultManager] removeItemAtPath:output error:nil];
+    
+    NSTask *task = [[NSTask alloc] init];
+    task.launchPath = [[NSBundle mainBundle] executablePath];
+    task.arguments = @[[@"-" stringByAppendingString:PMBenchmarkCountOption], [@(count) description],
+                       [@"-" stringByAppendingString:PMBenchmarkPayloadSizeOption], [@(payloadSize) description],
+                       [@"-" stringByAppendingString:PMBenchmarkBatchSizeOption], [@(batchSize) description],
+                       [@"-" stringByAppendingString:PMBenchmarkLookupsOption], [@(lookups) description],
+                       [@"-" stringByAppendingString:PMBenchmarkRoundsOption], [@(rounds) description],
+                       [@"-" stringByAppendingString:PMBenchmarkDirectoryOption], directory,
+                       [@"-" stringByAppendingString:PMBenchmarkWorkloadsOption], name,
+                       [@"-" stringByAppendingString:PMBenchmarkIsolateOption], @"NO",
+                       [@"-" stringByAppendingString:PMBenchmarkPopulateOption], @"NO",
+                       [@"-" stringByAppendingString:PMBenchmarkOutputOption], output,
+                       ];
+    
+    [task launch];
+    [task waitUntilExit];
+    
+    NSData *data = [NSData dataWithContentsOfFile:output];
+    
+    if (task.terminationStatus != 0 || !data)
+    {
+        fprintf(stderr, "%-24s failed (status %d)\n", name.UTF8String, task.terminationStatus);
+        return @[];
+    }
+    
+    return [NSJSONSerialization JSONObjectWithData:data options:0 error:nil][@"results"];
+}
+
+static void printResult(NSDictionary *result)
+{
+    fprintf(stderr, "%-24s %12.0f ops/s   p50 %10.1f us   p99 %10.1f us   rss %6.1f MB\n",
+            [result[@"name"] UTF8String],
+            [result[@"throughput"] doubleValue],
+            [result[@"latency_p50_us"] doubleValue],
+            [result[@"latency_p99_us"] doubleValue],
+            [result[@"peak_rss_bytes"] doubleValue] / (1024 * 1024));
+}
+
+#pragma mark Main
+
+int main(int argc, const char * argv[])
+{
+    @autoreleasepool
+    {
+        NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+        
+        [defaults registerDefaults:@{PMBenchmarkCountOption : @10000,
+                                     PMBenchmarkPayloadSizeOption : @512,
+                                     PMBenchmarkBatchSizeOption : @1000,
+                                     PMBenchmarkLookupsOption : @10000,
+                                     PMBenchmarkRoundsOption : @10,
+                                     PMBenchmarkWorkloadsOption : @"insert,insert-models,import,lookup-hot,lookup-cold,scan,decode-scaling,concurrent-reads,update,merge,purge,compression",
+                                     PMBenchmarkDirectoryOption : [NSTemporaryDirectory() stringByAppendingPathComponent:@"PMBenchmark"],
+                                     PMBenchmarkIsolateOption : @YES,
+                                     PMBenchmarkPopulateOption : @YES,
+                                     }];
+        
+        count = MAX([defaults integerForKey:PMBenchmarkCountOption], 1);
+        payloadSize = MAX([defaults integerForKey:PMBenchmarkPayloadSizeOption], 0);
+        batchSize = MAX([defaults integerForKey:PMBenchmarkBatchSizeOption], 1);
+        lookups = MAX([defaults integerForKey:PMBenchmarkLookupsOption], 1);
+        rounds = MAX([defaults integerForKey:PMBenchmarkRoundsOption], 1);
+        directory = [defaults stringForKey:PMBenchmarkDirectoryOption];
+        
+        NSArray *workloads = [[defaults stringForKey:PMBenchmarkWorkloadsOption] componentsSeparatedByString:@","];
+        BOOL isolates = [defaults boolForKey:PMBenchmarkIsolateOption];
+        
+        [[NSFileManager defaultManager] createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:nil];
+        
+        // Read workloads share a database, populated once by the main process.
+        __block PMSQLiteStore *store = nil;
+        
+        if ([defaults boolForKey:PMBenchmarkPopulateOption])
+            store = populatedStore();
+        
+        PMSQLiteStore *(^mainStore)() = ^PMSQLiteStore *() {
+            if (!store)
+                store = [[PMSQLiteStore alloc] initWithURL:mainStoreURL()];
+            return store;
+        };
+        
+        // Benchmarks by name, in running order. A workload names a single benchmark or a group of them (ie. "concurrent-reads").
+        NSMutableArray *names = [NSMutableArray array];
+        NSMutableDictionary *groups = [NSMutableDictionary dictionary];
+        NSMutableDictionary *blocks = [NSMutableDictionary dictionary];
+        
+        void (^add)(NSString *, NSString *, PMBenchmark *(^)()) = ^(NSString *group, NSString *name, PMBenchmark *(^block)()) {
+            [names addObject:name];
+            groups[name] = group;
+            blocks[name] = [block copy];
+        };
+        
+        NSUInteger cores = [NSProcessInfo processInfo].activeProcessorCount;
+        
+        // 1, 2, 4... up to the number of cores.
+        NSMutableArray *workerCounts = [NSMutableArray array];
+        for (NSUInteger workers = 1; workers < cores; workers *= 2)
+            [workerCounts addObject:@(workers)];
+        [workerCounts addObject:@(cores)];
+        
+        add(@"insert", @"insert", ^{ return insertBenchmark(); });
+        add(@"insert-models", @"insert-models", ^{ return insertModelsBenchmark(); });
+        add(@"import", @"import", ^{ return importBenchmark(); });
+        add(@"lookup-hot", @"lookup-hot", ^{ return lookupBenchmark(mainStore(), YES); });
+        add(@"lookup-cold", @"lookup-cold", ^{ return lookupBenchmark(mainStore(), NO); });
+        add(@"scan", @"scan", ^{ return scanBenchmark(mainStore()); });
+        
+        for (NSNumber *workers in workerCounts)
+            add(@"decode-scaling", [NSString stringWithFormat:@"decode-scaling-%@", workers], ^{ return decodeScalingBenchmark(mainStore(), workers.unsignedIntegerValue); });
+        
+        add(@"concurrent-reads", @"concurrent-reads-single", ^{ return concurrentReadsBenchmark(0); });
+        
+        for (NSNumber *readers in workerCounts)
+            add(@"concurrent-reads", [NSString stringWithFormat:@"concurrent-reads-%@", readers], ^{ return concurrentReadsBenchmark(readers.unsignedIntegerValue); });
+        
+        add(@"update", @"update", ^{ return updateBenchmark(mainStore()); });
+        add(@"merge", @"merge", ^{ return mergeBenchmark(mainStore()); });
+        add(@"purge", @"purge", ^{ return purgeBenchmark(); });
+        
+        // The store without compression is written first: the others compare their size with it.
+        for (NSNumber *threshold in @[@(-1), @0, @256, @1024])
+            add(@"compression", compressionBenchmarkName(threshold.integerValue), ^{ return compressionBenchmark(threshold.integerValue); });
+        
+        NSMutableArray *results = [NSMutableArray array];
+        
+        for (NSString *name in names)
+        {
+            if (![workloads containsObject:name] && ![workloads containsObject:groups[name]])
+                continue;
+            
+            @autoreleasepool
+            {
+                NSArray *benchmarkResults = nil;
+                
+                if (isolates)
+                    benchmarkResults = isolatedResults(name);
+                else
+                    benchmarkResults = @[[((PMBenchmark *(^)())blocks[name])() dictionaryRepresentation]];
+                
+                for (NSDictionary *result in benchmarkResults)
+                    printResult(result);
+                
+                [results addObjectsFromArray:benchmarkResults];
+            }
+        }
+        
+        NSProcessInfo *processInfo = [NSProcessInfo processInfo];
+        
+        NSDictionary *report = @{@"configuration" : @{PMBenchmarkCountOption : @(count),
+                                                      PMBenchmarkPayloadSizeOption : @(payloadSize),
+                                                      PMBenchmarkBatchSizeOption : @(batchSize),
+                                                      PMBenchmarkLookupsOption : @(lookups),
+                                                      PMBenchmarkRoundsOption : @(rounds),
+                                                      PMBenchmarkIsolateOption : @(isolates),
+                                                      },
+                                 @"system" : @{@"cores" : @(cores),
+                                               @"os" : processInfo.operatingSystemVersionString,
+                                               },
+                                 @"results" : results,
+                                 };
+        
+        NSData *data = [NSJSONSerialization dataWithJSONObject:report options:NSJSONWritingPrettyPrinted error:nil];
+        NSString *output = [defaults stringForKey:PMBenchmarkOutputOption];
+        
+        if (output)
+            [data writeToFile:output atomically:YES];
+        else
+            fwrite(data.bytes, 1, data.length, stdout);
+    }
+    
+    return 0;
+}
@@ -8,8 +8,76 @@
 
 #import "PMBaseObject.h"
 
+/**
+ * Faults forward the accessors of persistent properties with the Apple runtime forwarding entry points.
+ * Other runtimes (ie. GNUstep libobjc2) have no equivalent: objects are always loaded.
+ **/
+#if defined(__APPLE__)
+#define PMBaseObjectSupportsFaults 1
+#else
+#define PMBaseObjectSupportsFaults 0
+#endif
+
 @interface PMBaseObject (PrivateMethods)
 
 + (NSArray*)pmd_allPersistentPropertyNames;
 
+/**
+ * Returns the same names as `pmd_allPersistentPropertyNames` in a set, for constant time lookups.
+ **/
++ (NSSet*)pmd_allPersistentPropertyNameSet;
+
+/**
+ * Returns the runtime subclass used to turn instances of the current class into faults.
+ * @discussion The fault class forwards the accessors of all persistent properties to `forwardInvocation:`, and returns the current class from `-class`.
+ **/
++ (Class)pmd_faultClass;
+
+@end
+
+/**
+ * Main category extension for private methods.
+ **/
+@interface PMBaseObject ()
+
+/**
+ * Turns the object into a fault. Persistent values are not cleared.
+ **/
+- (void)pmd_turnIntoFault;
+
+/**
+ * Loads the persistent values of a fault from the persistent store of its context. If the object is not a fault, nothing is done.
+ **/
+- (void)pmd_fireFault;
+
+/**
+ * Sets a persistent value via KVC without tracking it as a change.
+ * @param value The value to set.
+ * @param key The name of a persistent property.
+ **/
+- (void)pmd_setPersistentValue:(id)value forKey:(NSString*)key;
+
+/**
+ * Sets the last update without tracking it as a change.
+ * @param lastUpdate The last update.
+ **/
+- (void)pmd_setLastUpdate:(NSDate*)lastUpdate;
+
+/**
+ * Unregisters the object from its context, without deleting it.
+ **/
+- (void)pmd_detachFromContext;
+
+/**
+ * Returns the current values of the properties changed since the last save, or of all persistent properties if 'hasChanges' has been set manually.
+ * @return A dictionary of values by property name. Nil values are represented by `NSNull`.
+ **/
+- (NSDictionary*)pmd_changedPersistentValues;
+
+/**
+ * Copies all persistent values from the given object without changing the 'hasChanges' flag.
+ * @param object An object of the same class.
+ **/
+- (void)pmd_setPersistentValuesWithObject:(PMBaseObject*)object;
+
 @end
@@ -8,38 +8,76 @@
 
 #import "PMBaseObject+PrivateMethods.h"
 
-static NSString* stringFromClass(Class theClass)
+#import <objc/runtime.h>
+#import <objc/message.h>
+#import <pthread.h>
+
+static NSString * const PMBaseObjectFaultClassPrefix = @"PMFault_";
+
+static SEL accessorForProperty(Class theClass, NSString *propertyName, BOOL setter)
 {
-    static NSMapTable *map = nil;
-    static dispatch_once_t onceToken;
-    dispatch_once(&onceToken, ^{
-        map = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsWeakMemory valueOptions:NSPointerFunctionsStrongMemory];
-    });
+    objc_property_t property = class_getProperty(theClass, propertyName.UTF8String);
     
-    NSString *string = [map objectForKey:theClass];
-    
-    if (!string)
+    if (property)
     {
-        string = NSStringFromClass(theClass);
-        [map setObject:string forKey:theClass];
+        char *name = property_copyAttributeValue(property, setter ? "S" : "G");
+        
+        if (name)
+        {
+            SEL selector = sel_registerName(name);
+            free(name);
+            return selector;
+        }
     }
     
-    return string;
+    if (!setter)
+        return NSSelectorFromString(propertyName);
+    
+    NSString *setterName = [NSString stringWithFormat:@"set%@%@:", [[propertyName substringToIndex:1] uppercaseString], [propertyName substringFromIndex:1]];
+    return NSSelectorFromString(setterName);
+}
+
+#if PMBaseObjectSupportsFaults
+static void addForwardingMethod(Class faultClass, Class originalClass, SEL selector)
+{
+    Method method = class_getInstanceMethod(originalClass, selector);
+    
+    if (!method)
+        return;
+    
+    const char *types = method_getTypeEncoding(method);
+    IMP forwardIMP = _objc_msgForward;
+    
+#if !defined(__arm64__)
+    // Large structs are returned by reference and need the stret variant.
+    if (types[0] == _C_STRUCT_B && [NSMethodSignature signatureWithObjCTypes:types].methodReturnLength > 2 * sizeof(void*))
+        forwardIMP = (IMP)_objc_msgForward_stret;
+#endif
+    
+    class_addMethod(faultClass, selector, forwardIMP, types);
 }
+#endif
 
 @implementation PMBaseObject (PrivateMethods)
 
+// Read on every KVC access and from concurrent decodings: readers must not block each other.
+static pthread_rwlock_t persistentPropertiesLock = PTHREAD_RWLOCK_INITIALIZER;
+static NSMapTable *persistentPropertyNames = nil;
+static NSMapTable *persistentPropertyNameSets = nil;
+
 + (NSArray*)pmd_allPersistentPropertyNames
 {
-    static NSMutableDictionary *persistentProperties = nil;
-    
     static dispatch_once_t onceToken1;
     dispatch_once(&onceToken1, ^{
-        persistentProperties = [NSMutableDictionary dictionary];
+        persistentPropertyNames = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality
+                                                        valueOptions:NSPointerFunctionsStrongMemory];
+        persistentPropertyNameSets = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsOpaqueMemory | NSPointerFunctionsOpaquePersonality
+                                                           valueOptions:NSPointerFunctionsStrongMemory];
     });
     
-    NSString *className = stringFromClass(self);
-    NSArray *propertyNames = persistentProperties[className];
+    pthread_rwlock_rdlock(&persistentPropertiesLock);
+    NSArray *propertyNames = [persistentPropertyNames objectForKey:self];
+    pthread_rwlock_unlock(&persistentPropertiesLock);
     
     if (!propertyNames)
     {
@@ -55,10 +93,79 @@ static NSString* stringFromClass(Class theClass)
         [array addObjectsFromArray:[self pmd_persistentPropertyNames]];
         
         propertyNames = [array copy];
-        persistentProperties[className] = propertyNames;
+        
+        pthread_rwlock_wrlock(&persistentPropertiesLock);
+        [persistentPropertyNames setObject:propertyNames forKey:self];
+        [persistentPropertyNameSets setObject:[NSSet setWithArray:propertyNames] forKey:self];
+        pthread_rwlock_unlock(&persistentPropertiesLock);
     }
     
     return propertyNames;
 }
 
++ (NSSet*)pmd_allPersistentPropertyNameSet
+{
+    pthread_rwlock_rdlock(&persistentPropertiesLock);
+    NSSet *propertyNameSet = [persistentPropertyNameSets objectForKey:self];
+    pthread_rwlock_unlock(&persistentPropertiesLock);
+    
+    if (propertyNameSet)
+        return propertyNameSet;
+    
+    // Both tables are filled at once.
+    return [NSSet setWithArray:[self pmd_allPersistentPropertyNames]];
+}
+
++ (Class)pmd_faultClass
+{
+#if !PMBaseObjectSupportsFaults
+    return self;
+#else
+    static NSMutableDictionary *faultClasses = nil;
+    
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        faultClasses = [NSMutableDictionary dictionary];
+    });
+    
+    NSString *className = NSStringFromClass(self);
+    
+    @synchronized(faultClasses)
+    {
+        Class faultClass = faultClasses[className];
+        
+        if (!faultClass)
+        {
+            Class originalClass = self;
+            const char *faultClassName = [PMBaseObjectFaultClassPrefix stringByAppendingString:className].UTF8String;
+            
+            faultClass = objc_getClass(faultClassName);
+            
+            if (!faultClass)
+            {
+                faultClass = objc_allocateClassPair(originalClass, faultClassName, 0);
+                
+                for (NSString *propertyName in [self pmd_allPersistentPropertyNames])
+                {
+                    addForwardingMethod(faultClass, originalClass, accessorForProperty(originalClass, propertyName, NO));
+                    addForwardingMethod(faultClass, originalClass, accessorForProperty(originalClass, propertyName, YES));
+                }
+                
+                // Faults must look like instances of the original class.
+                IMP classIMP = imp_implementationWithBlock(^Class(id object) {
+                    return originalClass;
+                });
+                class_addMethod(faultClass, @selector(class), classIMP, "#@:");
+                
+                objc_registerClassPair(faultClass);
+            }
+            
+            faultClasses[className] = faultClass;
+        }
+        
+        return faultClass;
+    }
+#endif
+}
+
 @end
@@ -106,6 +106,18 @@ extern NSString * const PMBaseObjectNilKeyException;
  **/
 @property (nonatomic, assign) BOOL hasChanges;
 
+/**
+ * The names of the persistent properties changed via KVC since the last save.
+ * @discussion Setting a persistent property to a value equal (`isEqual:`) to the current one is not a change. If you mutate a value in place, setting it again is not detected as a change: set the flag 'hasChanges' manually. The set is empty when 'hasChanges' has been set manually, and is cleared when 'hasChanges' is set to NO.
+ **/
+@property (nonatomic, strong, readonly) NSSet *changedPropertyNames;
+
+/**
+ * YES if the object is a fault, otherwise NO.
+ * @discussion A fault holds only its key and last update. Persistent values are loaded from the persistent store of its context the first time a persistent property is accessed, either via KVC or via its accessors. See `returnsObjectsAsFaults` in `PMObjectContext`.
+ **/
+@property (nonatomic, assign, readonly) BOOL isFault;
+
 @end
 
 
@@ -25,12 +25,18 @@
 #import "PMBaseObject.h"
 #import "PMBaseObject+PrivateMethods.h"
 
-#import "PMObjectContext.h"
+#import <objc/runtime.h>
+
+#import "PMObjectContext_Private.h"
+#import "PMBinaryCodec.h"
 
 NSString * const PMBaseObjectNilKeyException = @"PMBaseObjectNilKeyException";
 
 
 @implementation PMBaseObject
+{
+    NSMutableSet *_changedPropertyNames;
+}
 
 - (id)init
 {
@@ -67,7 +73,7 @@ NSString * const PMBaseObjectNilKeyException = @"PMBaseObjectNilKeyException";
         {
             id value = [aDecoder decodeObjectForKey:key];
             if (value)
-                [self setValue:value forKey:key];
+                [self pmd_setPersistentValue:value forKey:key];
         }
     }
     return self;
@@ -82,13 +88,10 @@ NSString * const PMBaseObjectNilKeyException = @"PMBaseObjectNilKeyException";
 
 - (id)copyWithZone:(NSZone *)zone
 {
-    NSMutableData *data = [NSMutableData data];
-    NSKeyedArchiver *archiver = [[NSKeyedArchiver alloc] initForWritingWithMutableData:data];
-    [archiver encodeRootObject:self];
-    [archiver finishEncoding];
+    PMBinaryCodec *codec = [PMBinaryCodec defaultCodec];
     
-    NSKeyedUnarchiver *unarchiver = [[NSKeyedUnarchiver alloc] initForReadingWithData:data];
-    PMBaseObject *copy = [unarchiver decodeObject];
+    NSData *data = [codec dataWithObject:self];
+    PMBaseObject *copy = [codec objectOfClass:self.class withData:data];
     
     return copy;
 }
@@ -136,22 +139,94 @@ NSString * const PMBaseObjectNilKeyException = @"PMBaseObjectNilKeyException";
 
 #pragma mark Key Value Coding
 
+- (id)valueForKey:(NSString *)key
+{
+    if (_isFault && [[self.class pmd_allPersistentPropertyNameSet] containsObject:key])
+        [self pmd_fireFault];
+    
+    return [super valueForKey:key];
+}
+
 - (void)setValue:(id)value forKey:(NSString *)key
 {
-    NSArray *persistentKeys = [self.class pmd_allPersistentPropertyNames];
+    if (![[self.class pmd_allPersistentPropertyNameSet] containsObject:key])
+    {
+        [super setValue:value forKey:key];
+        return;
+    }
+    
+    [self pmd_fireFault];
+    
+    // Setting an equal value is not a change: nothing to set nor to save.
+    id currentValue = [super valueForKey:key];
     
-    if ([persistentKeys containsObject:key])
-        _hasChanges = YES;
+    if (currentValue == value || [currentValue isEqual:value])
+        return;
     
     [super setValue:value forKey:key];
+    
+    if (!_changedPropertyNames)
+        _changedPropertyNames = [NSMutableSet set];
+    
+    [_changedPropertyNames addObject:key];
+    self.hasChanges = YES;
+}
+
+#pragma mark Key Value Observing
+
+- (void)addObserver:(NSObject *)observer forKeyPath:(NSString *)keyPath options:(NSKeyValueObservingOptions)options context:(void *)context
+{
+    // KVO replaces the class of the observed object: faults are fired before.
+    [self pmd_fireFault];
+    [super addObserver:observer forKeyPath:keyPath options:options context:context];
+}
+
+#pragma mark Faulting
+
+- (void)forwardInvocation:(NSInvocation *)anInvocation
+{
+    // Accessors of persistent properties are forwarded while the object is a fault.
+    if (_isFault)
+    {
+        [self pmd_fireFault];
+        [anInvocation invoke];
+        return;
+    }
+    
+    [super forwardInvocation:anInvocation];
 }
 
 #pragma mark Properties
 
 - (void)setLastUpdate:(NSDate *)lastUpdate
 {
+    if (_lastUpdate == lastUpdate || [_lastUpdate isEqualToDate:lastUpdate])
+        return;
+    
     _lastUpdate = lastUpdate;
-    _hasChanges = YES;
+    self.hasChanges = YES;
+}
+
+- (void)setHasChanges:(BOOL)hasChanges
+{
+    if (!hasChanges)
+        [_changedPropertyNames removeAllObjects];
+    
+    if (_hasChanges == hasChanges)
+        return;
+    
+    _hasChanges = hasChanges;
+    
+    // The context keeps track of its changed objects.
+    if (_hasChanges)
+        [_context pmd_didChangeBaseObject:self];
+    else
+        [_context pmd_didClearChangesOfBaseObject:self];
+}
+
+- (NSSet*)changedPropertyNames
+{
+    return _changedPropertyNames ? [_changedPropertyNames copy] : [NSSet set];
 }
 
 #pragma mark Public Methods
@@ -176,6 +251,72 @@ NSString * const PMBaseObjectNilKeyException = @"PMBaseObjectNilKeyException";
     return YES;
 }
 
+#pragma mark Private Methods
+
+- (void)pmd_turnIntoFault
+{
+    if (_isFault)
+        return;
+    
+    _isFault = YES;
+    object_setClass(self, [self.class pmd_faultClass]);
+}
+
+- (void)pmd_fireFault
+{
+    if (!_isFault)
+        return;
+    
+    _isFault = NO;
+    
+    // The fault class returns the original class.
+    object_setClass(self, self.class);
+    
+    [_context pmd_fireFaultOfBaseObject:self];
+}
+
+- (void)pmd_setPersistentValue:(id)value forKey:(NSString*)key
+{
+    [super setValue:value forKey:key];
+}
+
+- (void)pmd_setLastUpdate:(NSDate*)lastUpdate
+{
+    _lastUpdate = lastUpdate;
+}
+
+- (void)pmd_detachFromContext
+{
+    _context = nil;
+}
+
+- (NSDictionary*)pmd_changedPersistentValues
+{
+    NSArray *keys = _changedPropertyNames.count > 0 ? _changedPropertyNames.allObjects : [self.class pmd_allPersistentPropertyNames];
+    NSMutableDictionary *values = [NSMutableDictionary dictionaryWithCapacity:keys.count];
+    
+    // Values are snapshots: mutable values may be changed after the save, before the changes are merged.
+    for (NSString *key in keys)
+    {
+        id value = [super valueForKey:key];
+        
+        if ([value conformsToProtocol:@protocol(NSCopying)])
+            value = [value copy];
+        
+        values[key] = value ?: [NSNull null];
+    }
+    
+    return values;
+}
+
+- (void)pmd_setPersistentValuesWithObject:(PMBaseObject*)object
+{
+    NSArray *persistentKeys = [self.class pmd_allPersistentPropertyNames];
+    
+    for (NSString *key in persistentKeys)
+        [self pmd_setPersistentValue:[object valueForKey:key] forKey:key];
+}
+
 @end
 
 
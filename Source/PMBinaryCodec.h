@@ -0,0 +1,46 @@
+//
+//  PMBinaryCodec.h
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import "PMObjectCodec.h"
+
+/**
+ * Compact binary object codec.
+ *
+ * Persistent properties (see `pmd_persistentPropertyNames`) are written by position following a per-class schema: no property names are stored. Integers are written as variable length integers and strings, dates, URLs, data, arrays, sets and dictionaries are written natively. Any other `NSCoding` value is embedded as a keyed archive.
+ *
+ * Each encoded object carries a schema identifier computed from its class name and its persistent property names, and a 4 byte hash of the name of each written property. Data matching the current layout is decoded by position. Data written with another layout (ie. after adding a persistent property to a superclass, or removing or reordering properties) is decoded by matching the name hashes: values of removed properties are ignored, added properties have no value.
+ *
+ * Data written by the first version of the format, without name hashes, can only be decoded while the persistent properties of its class are the same or have been appended to. Otherwise decoding returns nil, and contexts report the object in a 'PMPersistentStoreDidFailNotification' notification.
+ *
+ * Data that has not been encoded with this codec is decoded using `NSKeyedUnarchiver`, so stores written with `PMKeyedArchiveCodec` can be read and are migrated as objects are saved again.
+ **/
+@interface PMBinaryCodec : NSObject <PMObjectCodec>
+
+/**
+ * Shared instance.
+ * @return The shared binary codec.
+ **/
++ (PMBinaryCodec*)defaultCodec;
+
+@end
@@ -0,0 +1,1047 @@
+//
+//  PMBinaryCodec.m
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import "PMBinaryCodec.h"
+
+#import <objc/runtime.h>
+
+#import "PMBaseObject+PrivateMethods.h"
+#import "PMKeyedArchiveCodec.h"
+
+/**
+ * Every binary encoded object starts with these bytes, followed by the format version. Keyed archives start with "bplist".
+ **/
+static const uint8_t PMBinaryCodecMagic[3] = {'P', 'M', 'B'};
+
+/**
+ * Length of the magic and the format version.
+ **/
+static NSUInteger const PMBinaryCodecHeaderLength = 4;
+
+/**
+ * Format versions. Version 1 writes values by position only, version 2 also writes a hash of the name of each property.
+ **/
+static uint8_t const PMBinaryCodecVersionPositional = 1;
+static uint8_t const PMBinaryCodecVersionNamed = 2;
+
+/**
+ * Value types.
+ **/
+typedef enum __PMBinaryValueTag
+{
+    PMBinaryValueTagNil = 0,
+    PMBinaryValueTagNull,
+    PMBinaryValueTagTrue,
+    PMBinaryValueTagFalse,
+    PMBinaryValueTagInteger,
+    PMBinaryValueTagUnsignedInteger,
+    PMBinaryValueTagFloat,
+    PMBinaryValueTagDouble,
+    PMBinaryValueTagString,
+    PMBinaryValueTagData,
+    PMBinaryValueTagDate,
+    PMBinaryValueTagURL,
+    PMBinaryValueTagArray,
+    PMBinaryValueTagSet,
+    PMBinaryValueTagDictionary,
+    PMBinaryValueTagArchive
+} PMBinaryValueTag;
+
+/**
+ * Placeholder for persistent properties without value.
+ **/
+static id PMBinaryMissingValue(void)
+{
+    static id missingValue = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        missingValue = [[NSObject alloc] init];
+    });
+    return missingValue;
+}
+
+#pragma mark - Writing
+
+static void PMWriteByte(NSMutableData *data, uint8_t byte)
+{
+    [data appendBytes:&byte length:1];
+}
+
+static void PMWriteVarint(NSMutableData *data, uint64_t value)
+{
+    uint8_t buffer[10];
+    NSUInteger length = 0;
+    
+    while (value >= 0x80)
+    {
+        buffer[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buffer[length++] = (uint8_t)value;
+    
+    [data appendBytes:buffer length:length];
+}
+
+static void PMWriteSignedVarint(NSMutableData *data, int64_t value)
+{
+    // ZigZag encoding, so small negative values are short too.
+    PMWriteVarint(data, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static void PMWriteDouble(NSMutableData *data, double value)
+{
+    union { double d; unsigned long long u; } bits;
+    bits.d = value;
+    unsigned long long little = NSSwapHostLongLongToLittle(bits.u);
+    [data appendBytes:&little length:sizeof(little)];
+}
+
+static void PMWriteFloat(NSMutableData *data, float value)
+{
+    union { float f; unsigned int u; } bits;
+    bits.f = value;
+    unsigned int little = NSSwapHostIntToLittle(bits.u);
+    [data appendBytes:&little length:sizeof(little)];
+}
+
+static void PMWriteFixed32(NSMutableData *data, uint32_t value)
+{
+    unsigned int little = NSSwapHostIntToLittle(value);
+    [data appendBytes:&little length:sizeof(little)];
+}
+
+static void PMWriteString(NSMutableData *data, NSString *string)
+{
+    NSUInteger length = [string lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+    PMWriteVarint(data, length);
+    
+    NSUInteger offset = data.length;
+    [data increaseLengthBy:length];
+    [string getBytes:(uint8_t*)data.mutableBytes + offset
+           maxLength:length
+          usedLength:NULL
+            encoding:NSUTF8StringEncoding
+             options:0
+               range:NSMakeRange(0, string.length)
+      remainingRange:NULL];
+}
+
+static void PMWriteData(NSMutableData *data, NSData *value)
+{
+    PMWriteVarint(data, value.length);
+    [data appendData:value];
+}
+
+static void PMWriteNumber(NSMutableData *data, NSNumber *number)
+{
+    const char *type = number.objCType;
+    
+    switch (type[0])
+    {
+        case 'B':
+            PMWriteByte(data, number.boolValue ? PMBinaryValueTagTrue : PMBinaryValueTagFalse);
+            break;
+            
+        case 'f':
+            PMWriteByte(data, PMBinaryValueTagFloat);
+            PMWriteFloat(data, number.floatValue);
+            break;
+            
+        case 'd':
+            PMWriteByte(data, PMBinaryValueTagDouble);
+            PMWriteDouble(data, number.doubleValue);
+            break;
+            
+        case 'C':
+        case 'S':
+        case 'I':
+        case 'L':
+        case 'Q':
+        {
+            unsigned long long value = number.unsignedLongLongValue;
+            if (value > INT64_MAX)
+            {
+                PMWriteByte(data, PMBinaryValueTagUnsignedInteger);
+                PMWriteVarint(data, value);
+            }
+            else
+            {
+                PMWriteByte(data, PMBinaryValueTagInteger);
+                PMWriteSignedVarint(data, (int64_t)value);
+            }
+            break;
+        }
+            
+        default:
+            PMWriteByte(data, PMBinaryValueTagInteger);
+            PMWriteSignedVarint(data, number.longLongValue);
+            break;
+    }
+}
+
+static void PMWriteValue(NSMutableData *data, id value)
+{
+    if (value == nil)
+    {
+        PMWriteByte(data, PMBinaryValueTagNil);
+    }
+    else if ([value isKindOfClass:[NSString class]])
+    {
+        PMWriteByte(data, PMBinaryValueTagString);
+        PMWriteString(data, value);
+    }
+    else if ([value isKindOfClass:[NSNumber class]] && ![value isKindOfClass:[NSDecimalNumber class]])
+    {
+        PMWriteNumber(data, value);
+    }
+    else if ([value isKindOfClass:[NSNull class]])
+    {
+        PMWriteByte(data, PMBinaryValueTagNull);
+    }
+    else if ([value isKindOfClass:[NSData class]])
+    {
+        PMWriteByte(data, PMBinaryValueTagData);
+        PMWriteData(data, value);
+    }
+    else if ([value isKindOfClass:[NSDate class]])
+    {
+        PMWriteByte(data, PMBinaryValueTagDate);
+        PMWriteDouble(data, [value timeIntervalSinceReferenceDate]);
+    }
+    else if ([value isKindOfClass:[NSURL class]] && [value baseURL] == nil)
+    {
+        PMWriteByte(data, PMBinaryValueTagURL);
+        PMWriteString(data, [value absoluteString]);
+    }
+    else if ([value isKindOfClass:[NSArray class]] || [value isKindOfClass:[NSSet class]])
+    {
+        PMWriteByte(data, [value isKindOfClass:[NSArray class]] ? PMBinaryValueTagArray : PMBinaryValueTagSet);
+        PMWriteVarint(data, [value count]);
+        for (id item in value)
+            PMWriteValue(data, item);
+    }
+    else if ([value isKindOfClass:[NSDictionary class]])
+    {
+        PMWriteByte(data, PMBinaryValueTagDictionary);
+        PMWriteVarint(data, [value count]);
+        for (id key in value)
+        {
+            PMWriteValue(data, key);
+            PMWriteValue(data, [value objectForKey:key]);
+        }
+    }
+    else if ([value conformsToProtocol:@protocol(NSCoding)])
+    {
+        PMWriteByte(data, PMBinaryValueTagArchive);
+        PMWriteData(data, [NSKeyedArchiver archivedDataWithRootObject:value]);
+    }
+    else
+    {
+        NSString *reason = [NSString stringWithFormat:@"Cannot encode value of class %@: it doesn't conform to NSCoding.", NSStringFromClass([value class])];
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+    }
+}
+
+#pragma mark - Reading
+
+typedef struct __PMBinaryReader
+{
+    const uint8_t *bytes;
+    NSUInteger length;
+    NSUInteger offset;
+    BOOL failed;
+} PMBinaryReader;
+
+static const uint8_t* PMReadBytes(PMBinaryReader *reader, NSUInteger length)
+{
+    if (reader->failed || reader->length - reader->offset < length)
+    {
+        reader->failed = YES;
+        return NULL;
+    }
+    
+    const uint8_t *bytes = reader->bytes + reader->offset;
+    reader->offset += length;
+    return bytes;
+}
+
+static uint64_t PMReadVarint(PMBinaryReader *reader)
+{
+    uint64_t value = 0;
+    NSUInteger shift = 0;
+    
+    while (!reader->failed)
+    {
+        if (reader->offset >= reader->length || shift > 63)
+        {
+            reader->failed = YES;
+            break;
+        }
+        
+        uint8_t byte = reader->bytes[reader->offset++];
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        
+        if ((byte & 0x80) == 0)
+            return value;
+        
+        shift += 7;
+    }
+    
+    return 0;
+}
+
+static int64_t PMReadSignedVarint(PMBinaryReader *reader)
+{
+    uint64_t value = PMReadVarint(reader);
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static double PMReadDouble(PMBinaryReader *reader)
+{
+    const uint8_t *bytes = PMReadBytes(reader, sizeof(unsigned long long));
+    if (!bytes)
+        return 0;
+    
+    unsigned long long little;
+    memcpy(&little, bytes, sizeof(little));
+    
+    union { double d; unsigned long long u; } bits;
+    bits.u = NSSwapLittleLongLongToHost(little);
+    return bits.d;
+}
+
+static uint32_t PMReadFixed32(PMBinaryReader *reader)
+{
+    const uint8_t *bytes = PMReadBytes(reader, sizeof(unsigned int));
+    if (!bytes)
+        return 0;
+    
+    unsigned int little;
+    memcpy(&little, bytes, sizeof(little));
+    
+    return NSSwapLittleIntToHost(little);
+}
+
+static float PMReadFloat(PMBinaryReader *reader)
+{
+    const uint8_t *bytes = PMReadBytes(reader, sizeof(unsigned int));
+    if (!bytes)
+        return 0;
+    
+    unsigned int little;
+    memcpy(&little, bytes, sizeof(little));
+    
+    union { float f; unsigned int u; } bits;
+    bits.u = NSSwapLittleIntToHost(little);
+    return bits.f;
+}
+
+static NSUInteger PMReadCount(PMBinaryReader *reader)
+{
+    uint64_t count = PMReadVarint(reader);
+    
+    // Every value takes at least one byte.
+    if (count > reader->length - reader->offset)
+    {
+        reader->failed = YES;
+        return 0;
+    }
+    
+    return (NSUInteger)count;
+}
+
+static NSString* PMReadString(PMBinaryReader *reader)
+{
+    NSUInteger length = PMReadCount(reader);
+    const uint8_t *bytes = PMReadBytes(reader, length);
+    
+    if (!bytes)
+        return nil;
+    
+    NSString *string = [[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding];
+    
+    if (!string)
+        reader->failed = YES;
+    
+    return string;
+}
+
+static NSData* PMReadData(PMBinaryReader *reader)
+{
+    NSUInteger length = PMReadCount(reader);
+    const uint8_t *bytes = PMReadBytes(reader, length);
+    
+    if (!bytes)
+        return nil;
+    
+    return [NSData dataWithBytes:bytes length:length];
+}
+
+static id PMReadValue(PMBinaryReader *reader);
+
+static id PMReadCollectionItem(PMBinaryReader *reader)
+{
+    id item = PMReadValue(reader);
+    
+    if (!item)
+        reader->failed = YES;
+    
+    return item;
+}
+
+static id PMReadValue(PMBinaryReader *reader)
+{
+    const uint8_t *tag = PMReadBytes(reader, 1);
+    
+    if (!tag)
+        return nil;
+    
+    switch (*tag)
+    {
+        case PMBinaryValueTagNil:
+            return nil;
+            
+        case PMBinaryValueTagNull:
+            return [NSNull null];
+            
+        case PMBinaryValueTagTrue:
+            return [NSNumber numberWithBool:YES];
+            
+        case PMBinaryValueTagFalse:
+            return [NSNumber numberWithBool:NO];
+            
+        case PMBinaryValueTagInteger:
+            return [NSNumber numberWithLongLong:PMReadSignedVarint(reader)];
+            
+        case PMBinaryValueTagUnsignedInteger:
+            return [NSNumber numberWithUnsignedLongLong:PMReadVarint(reader)];
+            
+        case PMBinaryValueTagFloat:
+            return [NSNumber numberWithFloat:PMReadFloat(reader)];
+            
+        case PMBinaryValueTagDouble:
+            return [NSNumber numberWithDouble:PMReadDouble(reader)];
+            
+        case PMBinaryValueTagString:
+            return PMReadString(reader);
+            
+        case PMBinaryValueTagData:
+            return PMReadData(reader);
+            
+        case PMBinaryValueTagDate:
+            return [NSDate dateWithTimeIntervalSinceReferenceDate:PMReadDouble(reader)];
+            
+        case PMBinaryValueTagURL:
+        {
+            NSString *string = PMReadString(reader);
+            return string ? [NSURL URLWithString:string] : nil;
+        }
+            
+        case PMBinaryValueTagArray:
+        case PMBinaryValueTagSet:
+        {
+            NSUInteger count = PMReadCount(reader);
+            NSMutableArray *array = [NSMutableArray arrayWithCapacity:count];
+            
+            for (NSUInteger i = 0; i < count && !reader->failed; ++i)
+            {
+                id item = PMReadCollectionItem(reader);
+                if (item)
+                    [array addObject:item];
+            }
+            
+            if (reader->failed)
+                return nil;
+            
+            if (*tag == PMBinaryValueTagSet)
+                return [NSSet setWithArray:array];
+            
+            return array;
+        }
+            
+        case PMBinaryValueTagDictionary:
+        {
+            NSUInteger count = PMReadCount(reader);
+            NSMutableDictionary *dictionary = [NSMutableDictionary dictionaryWithCapacity:count];
+            
+            for (NSUInteger i = 0; i < count && !reader->failed; ++i)
+            {
+                id key = PMReadCollectionItem(reader);
+                id value = PMReadCollectionItem(reader);
+                if (key && value)
+                    [dictionary setObject:value forKey:key];
+            }
+            
+            if (reader->failed)
+                return nil;
+            
+            return dictionary;
+        }
+            
+        case PMBinaryValueTagArchive:
+        {
+            NSData *data = PMReadData(reader);
+            
+            if (!data)
+                return nil;
+            
+            id value = nil;
+            @try
+            {
+                value = [NSKeyedUnarchiver unarchiveObjectWithData:data];
+            }
+            @catch (NSException *exception)
+            {
+                value = nil;
+            }
+            
+            if (!value)
+                reader->failed = YES;
+            
+            return value;
+        }
+            
+        default:
+            reader->failed = YES;
+            return nil;
+    }
+}
+
+#pragma mark - Schema
+
+/**
+ * Persistent property layout of a class.
+ **/
+@interface PMBinaryCodecSchema : NSObject
+
+- (id)initWithClass:(Class)objectClass;
+
+@property (nonatomic, strong, readonly) NSArray *propertyNames;
+@property (nonatomic, strong, readonly) NSDictionary *propertyIndexes;
+
+- (uint32_t)identifierForPropertyCount:(NSUInteger)count;
+- (uint32_t)nameHashAtIndex:(NSUInteger)index;
+- (NSNumber*)indexForNameHash:(uint32_t)nameHash;
+- (BOOL)isMutablePropertyAtIndex:(NSUInteger)index;
+
+@end
+
+@implementation PMBinaryCodecSchema
+{
+    uint32_t *_identifiers;
+    uint32_t *_nameHashes;
+    NSDictionary *_indexesByNameHash;
+    NSIndexSet *_mutablePropertyIndexes;
+}
+
++ (PMBinaryCodecSchema*)schemaForClass:(Class)objectClass
+{
+    static NSMutableDictionary *schemas = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        schemas = [NSMutableDictionary dictionary];
+    });
+    
+    NSString *className = NSStringFromClass(objectClass);
+    
+    @synchronized(schemas)
+    {
+        PMBinaryCodecSchema *schema = schemas[className];
+        
+        if (!schema)
+        {
+            schema = [[PMBinaryCodecSchema alloc] initWithClass:objectClass];
+            schemas[className] = schema;
+        }
+        
+        return schema;
+    }
+}
+
+- (id)initWithClass:(Class)objectClass
+{
+    self = [super init];
+    if (self)
+    {
+        _propertyNames = [objectClass pmd_allPersistentPropertyNames];
+        
+        NSMutableDictionary *indexes = [NSMutableDictionary dictionaryWithCapacity:_propertyNames.count];
+        NSMutableIndexSet *mutableIndexes = [NSMutableIndexSet indexSet];
+        
+        // The identifier of the first N properties is a FNV-1a hash of the class name and the N property names.
+        // Data encoded with a prefix of the current properties can be still decoded.
+        _identifiers = malloc(sizeof(uint32_t) * (_propertyNames.count + 1));
+        _nameHashes = malloc(sizeof(uint32_t) * MAX(_propertyNames.count, 1));
+        
+        NSMutableDictionary *indexesByNameHash = [NSMutableDictionary dictionaryWithCapacity:_propertyNames.count];
+        
+        uint32_t hash = 2166136261u;
+        const char *className = class_getName(objectClass);
+        for (const char *c = className; *c; ++c)
+            hash = (hash ^ (uint8_t)*c) * 16777619u;
+        
+        _identifiers[0] = hash;
+        
+        [_propertyNames enumerateObjectsUsingBlock:^(NSString *name, NSUInteger idx, BOOL *stop) {
+            indexes[name] = @(idx);
+            
+            // A zero byte separates names.
+            uint32_t h = _identifiers[idx] * 16777619u;
+            for (const char *c = name.UTF8String; *c; ++c)
+                h = (h ^ (uint8_t)*c) * 16777619u;
+            _identifiers[idx + 1] = h;
+            
+            // Each property is also identified by the FNV-1a hash of its name alone, to decode data written with another layout.
+            uint32_t nameHash = 2166136261u;
+            for (const char *c = name.UTF8String; *c; ++c)
+                nameHash = (nameHash ^ (uint8_t)*c) * 16777619u;
+            _nameHashes[idx] = nameHash;
+            indexesByNameHash[@(nameHash)] = @(idx);
+            
+            objc_property_t property = class_getProperty(objectClass, name.UTF8String);
+            if (property)
+            {
+                const char *attributes = property_getAttributes(property);
+                if (attributes && strncmp(attributes, "T@\"NSMutable", 12) == 0)
+                    [mutableIndexes addIndex:idx];
+            }
+        }];
+        
+        _propertyIndexes = [indexes copy];
+        _indexesByNameHash = [indexesByNameHash copy];
+        _mutablePropertyIndexes = [mutableIndexes copy];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_identifiers);
+    free(_nameHashes);
+}
+
+- (uint32_t)identifierForPropertyCount:(NSUInteger)count
+{
+    if (count > _propertyNames.count)
+        return 0;
+    
+    return _identifiers[count];
+}
+
+- (uint32_t)nameHashAtIndex:(NSUInteger)index
+{
+    return _nameHashes[index];
+}
+
+- (NSNumber*)indexForNameHash:(uint32_t)nameHash
+{
+    return _indexesByNameHash[@(nameHash)];
+}
+
+- (BOOL)isMutablePropertyAtIndex:(NSUInteger)index
+{
+    return [_mutablePropertyIndexes containsIndex:index];
+}
+
+@end
+
+#pragma mark - Coders
+
+/**
+ * Keyed coder collecting the values encoded by `encodeWithCoder:`.
+ **/
+@interface PMBinaryEncoder : NSCoder
+
+- (id)initWithSchema:(PMBinaryCodecSchema*)schema;
+- (NSData*)encodedData;
+
+@end
+
+@implementation PMBinaryEncoder
+{
+    PMBinaryCodecSchema *_schema;
+    NSMutableArray *_values;
+    NSMutableDictionary *_extraValues;
+}
+
+- (id)initWithSchema:(PMBinaryCodecSchema*)schema
+{
+    self = [super init];
+    if (self)
+    {
+        _schema = schema;
+        
+        NSUInteger count = schema.propertyNames.count;
+        _values = [NSMutableArray arrayWithCapacity:count];
+        for (NSUInteger i = 0; i < count; ++i)
+            [_values addObject:PMBinaryMissingValue()];
+    }
+    return self;
+}
+
+- (NSData*)encodedData
+{
+    id missingValue = PMBinaryMissingValue();
+    
+    // Trailing properties without value are not written.
+    NSUInteger count = _values.count;
+    while (count > 0 && _values[count - 1] == missingValue)
+        count -= 1;
+    
+    NSMutableData *data = [NSMutableData dataWithCapacity:64];
+    [data appendBytes:PMBinaryCodecMagic length:sizeof(PMBinaryCodecMagic)];
+    PMWriteByte(data, PMBinaryCodecVersionNamed);
+    
+    PMWriteVarint(data, [_schema identifierForPropertyCount:count]);
+    PMWriteVarint(data, count);
+    
+    for (NSUInteger i = 0; i < count; ++i)
+        PMWriteFixed32(data, [_schema nameHashAtIndex:i]);
+    
+    for (NSUInteger i = 0; i < count; ++i)
+    {
+        id value = _values[i];
+        PMWriteValue(data, value == missingValue ? nil : value);
+    }
+    
+    // Values encoded for keys not declared as persistent properties carry their key.
+    PMWriteVarint(data, _extraValues.count);
+    for (NSString *key in _extraValues)
+    {
+        PMWriteValue(data, key);
+        PMWriteValue(data, _extraValues[key]);
+    }
+    
+    return data;
+}
+
+- (BOOL)allowsKeyedCoding
+{
+    return YES;
+}
+
+- (void)encodeObject:(id)object forKey:(NSString*)key
+{
+    NSNumber *index = _schema.propertyIndexes[key];
+    
+    if (index)
+    {
+        _values[index.unsignedIntegerValue] = object ? object : PMBinaryMissingValue();
+    }
+    else if (object)
+    {
+        if (!_extraValues)
+            _extraValues = [NSMutableDictionary dictionary];
+        
+        _extraValues[key] = object;
+    }
+}
+
+- (void)encodeConditionalObject:(id)object forKey:(NSString*)key
+{
+    [self encodeObject:object forKey:key];
+}
+
+- (void)encodeBool:(BOOL)boolv forKey:(NSString*)key
+{
+    [self encodeObject:[NSNumber numberWithBool:boolv] forKey:key];
+}
+
+- (void)encodeInt:(int)intv forKey:(NSString*)key
+{
+    [self encodeObject:[NSNumber numberWithInt:intv] forKey:key];
+}
+
+- (void)encodeInt32:(int32_t)intv forKey:(NSString*)key
+{
+    [self encodeObject:[NSNumber numberWithInt:intv] forKey:key];
+}
+
+- (void)encodeInt64:(int64_t)intv forKey:(NSString*)key
+{
+    [self encodeObject:[NSNumber numberWithLongLong:intv] forKey:key];
+}
+
+- (void)encodeInteger:(NSInteger)intv forKey:(NSString*)key
+{
+    [self encodeObject:[NSNumber numberWithInteger:intv] forKey:key];
+}
+
+- (void)encodeFloat:(float)realv forKey:(NSString*)key
+{
+    [self encodeObject:[NSNumber numberWithFloat:realv] forKey:key];
+}
+
+- (void)encodeDouble:(double)realv forKey:(NSString*)key
+{
+    [self encodeObject:[NSNumber numberWithDouble:realv] forKey:key];
+}
+
+- (void)encodeBytes:(const uint8_t*)bytesp length:(NSUInteger)lenv forKey:(NSString*)key
+{
+    [self encodeObject:[NSData dataWithBytes:bytesp length:lenv] forKey:key];
+}
+
+@end
+
+/**
+ * Keyed coder serving the values read from binary encoded data to `initWithCoder:`.
+ **/
+@interface PMBinaryDecoder : NSCoder
+
+- (id)initWithSchema:(PMBinaryCodecSchema*)schema values:(NSArray*)values extraValues:(NSDictionary*)extraValues;
+
+@end
+
+@implementation PMBinaryDecoder
+{
+    PMBinaryCodecSchema *_schema;
+    NSArray *_values;
+    NSDictionary *_extraValues;
+}
+
+- (id)initWithSchema:(PMBinaryCodecSchema*)schema values:(NSArray*)values extraValues:(NSDictionary*)extraValues
+{
+    self = [super init];
+    if (self)
+    {
+        _schema = schema;
+        _values = values;
+        _extraValues = extraValues;
+    }
+    return self;
+}
+
+- (BOOL)allowsKeyedCoding
+{
+    return YES;
+}
+
+- (BOOL)containsValueForKey:(NSString*)key
+{
+    return [self decodeObjectForKey:key] != nil;
+}
+
+- (id)decodeObjectForKey:(NSString*)key
+{
+    NSNumber *index = _schema.propertyIndexes[key];
+    
+    if (!index)
+        return _extraValues[key];
+    
+    NSUInteger i = index.unsignedIntegerValue;
+    
+    if (i >= _values.count)
+        return nil;
+    
+    id value = _values[i];
+    
+    if (value == PMBinaryMissingValue())
+        return nil;
+    
+    // Collections are decoded immutable: honor the declared type of the property.
+    if ([_schema isMutablePropertyAtIndex:i] && [value respondsToSelector:@selector(mutableCopyWithZone:)])
+        return [value mutableCopy];
+    
+    return value;
+}
+
+- (id)decodeObjectOfClass:(Class)aClass forKey:(NSString*)key
+{
+    id value = [self decodeObjectForKey:key];
+    return [value isKindOfClass:aClass] ? value : nil;
+}
+
+- (BOOL)decodeBoolForKey:(NSString*)key
+{
+    return [[self decodeObjectForKey:key] boolValue];
+}
+
+- (int)decodeIntForKey:(NSString*)key
+{
+    return [[self decodeObjectForKey:key] intValue];
+}
+
+- (int32_t)decodeInt32ForKey:(NSString*)key
+{
+    return [[self decodeObjectForKey:key] intValue];
+}
+
+- (int64_t)decodeInt64ForKey:(NSString*)key
+{
+    return [[self decodeObjectForKey:key] longLongValue];
+}
+
+- (NSInteger)decodeIntegerForKey:(NSString*)key
+{
+    return [[self decodeObjectForKey:key] integerValue];
+}
+
+- (float)decodeFloatForKey:(NSString*)key
+{
+    return [[self decodeObjectForKey:key] floatValue];
+}
+
+- (double)decodeDoubleForKey:(NSString*)key
+{
+    return [[self decodeObjectForKey:key] doubleValue];
+}
+
+- (const uint8_t*)decodeBytesForKey:(NSString*)key returnedLength:(NSUInteger*)lengthp
+{
+    NSData *data = [self decodeObjectForKey:key];
+    
+    if (lengthp)
+        *lengthp = data.length;
+    
+    return data.bytes;
+}
+
+@end
+
+#pragma mark - Codec
+
+@implementation PMBinaryCodec
+{
+    PMKeyedArchiveCodec *_keyedArchiveCodec;
+}
+
++ (PMBinaryCodec*)defaultCodec
+{
+    static PMBinaryCodec *codec = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        codec = [[PMBinaryCodec alloc] init];
+    });
+    return codec;
+}
+
+- (id)init
+{
+    self = [super init];
+    if (self)
+    {
+        _keyedArchiveCodec = [[PMKeyedArchiveCodec alloc] init];
+    }
+    return self;
+}
+
+- (NSData*)dataWithObject:(PMBaseObject*)object
+{
+    PMBinaryCodecSchema *schema = [PMBinaryCodecSchema schemaForClass:[object class]];
+    
+    PMBinaryEncoder *encoder = [[PMBinaryEncoder alloc] initWithSchema:schema];
+    [object encodeWithCoder:encoder];
+    
+    return [encoder encodedData];
+}
+
+- (PMBaseObject*)objectOfClass:(Class)objectClass withData:(NSData*)data
+{
+    if (data.length < PMBinaryCodecHeaderLength || memcmp(data.bytes, PMBinaryCodecMagic, sizeof(PMBinaryCodecMagic)) != 0)
+        return [_keyedArchiveCodec objectOfClass:objectClass withData:data];
+    
+    if (![objectClass isSubclassOfClass:[PMBaseObject class]])
+        return nil;
+    
+    uint8_t version = ((const uint8_t*)data.bytes)[sizeof(PMBinaryCodecMagic)];
+    
+    if (version != PMBinaryCodecVersionPositional && version != PMBinaryCodecVersionNamed)
+        return nil;
+    
+    PMBinaryCodecSchema *schema = [PMBinaryCodecSchema schemaForClass:objectClass];
+    
+    PMBinaryReader reader = {data.bytes, data.length, PMBinaryCodecHeaderLength, NO};
+    
+    uint64_t identifier = PMReadVarint(&reader);
+    NSUInteger count = PMReadCount(&reader);
+    
+    if (reader.failed)
+        return nil;
+    
+    BOOL matchesLayout = count <= schema.propertyNames.count && identifier == [schema identifierForPropertyCount:count];
+    
+    // Values are indexed by the current layout. Data written with another layout is mapped by the hashes of the property names.
+    NSMutableArray *indexes = nil;
+    
+    if (version == PMBinaryCodecVersionNamed)
+    {
+        if (count > (reader.length - reader.offset) / sizeof(uint32_t))
+            return nil;
+        
+        indexes = [NSMutableArray arrayWithCapacity:count];
+        
+        for (NSUInteger i = 0; i < count; ++i)
+        {
+            NSNumber *index = [schema indexForNameHash:PMReadFixed32(&reader)];
+            
+            // Removed properties are skipped.
+            [indexes addObject:index ?: [NSNull null]];
+        }
+    }
+    else if (!matchesLayout)
+    {
+        // Positional data written with another layout cannot be decoded.
+        return nil;
+    }
+    
+    NSUInteger valueCount = matchesLayout ? count : schema.propertyNames.count;
+    NSMutableArray *values = [NSMutableArray arrayWithCapacity:valueCount];
+    for (NSUInteger i = 0; i < valueCount; ++i)
+        [values addObject:PMBinaryMissingValue()];
+    
+    for (NSUInteger i = 0; i < count && !reader.failed; ++i)
+    {
+        id value = PMReadValue(&reader);
+        NSNumber *index = matchesLayout ? @(i) : indexes[i];
+        
+        if (value && index != (id)[NSNull null])
+            values[index.unsignedIntegerValue] = value;
+    }
+    
+    NSUInteger extraCount = PMReadCount(&reader);
+    NSMutableDictionary *extraValues = nil;
+    
+    if (extraCount > 0)
+    {
+        extraValues = [NSMutableDictionary dictionaryWithCapacity:extraCount];
+        for (NSUInteger i = 0; i < extraCount && !reader.failed; ++i)
+        {
+            id key = PMReadValue(&reader);
+            id value = PMReadValue(&reader);
+            if ([key isKindOfClass:[NSString class]] && value)
+                extraValues[key] = value;
+        }
+    }
+    
+    if (reader.failed)
+        return nil;
+    
+    PMBinaryDecoder *decoder = [[PMBinaryDecoder alloc] initWithSchema:schema values:values extraValues:extraValues];
+    
+    return [[objectClass alloc] initWithCoder:decoder];
+}
+
+@end
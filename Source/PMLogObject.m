@@ -0,0 +1,113 @@
+//
+//  PMLogObject.m
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import "PMLogObject_Private.h"
+
+#import "PMLogStore_Private.h"
+
+@implementation PMLogObject
+{
+    NSData *_pendingData;
+}
+
+- (id)initWithKey:(NSString*)key andType:(NSString*)type
+{
+    self = [super init];
+    if (self)
+    {
+        _key = key;
+        _type = type;
+        _hasChanges = NO;
+        _dataOffset = NSNotFound;
+        _dataLength = 0;
+        _recordLength = 0;
+    }
+    return self;
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"%@: <key:%@> <type:%@> <lastUpdate:%@> <offset:%ld> <dataLength:%ld>",[super description], _key, _type, _lastUpdate.description, (long)_dataOffset, (long)_dataLength];
+}
+
+#pragma mark Properties
+
+- (NSData*)data
+{
+    NSData *data = [self pmd_pendingData];
+    
+    if (data)
+        return data;
+    
+    // Written data is read from the memory mapped log file, without copying.
+    return [_persistentStore pmd_mappedDataOfObject:self];
+}
+
+- (void)setData:(NSData *)data
+{
+    @synchronized(self)
+    {
+        _pendingData = data ? data : [NSData data];
+    }
+    
+    [self pmd_setHasChanges:YES];
+}
+
+- (void)setLastUpdate:(NSDate *)lastUpdate
+{
+    BOOL sameValue = [_lastUpdate isEqual:lastUpdate];
+    
+    _lastUpdate = lastUpdate;
+    
+    [self pmd_setHasChanges:_hasChanges || !sameValue];
+}
+
+#pragma mark Private Methods
+
+- (NSData*)pmd_pendingData
+{
+    @synchronized(self)
+    {
+        return _pendingData;
+    }
+}
+
+- (void)pmd_clearPendingData:(NSData*)data
+{
+    @synchronized(self)
+    {
+        if (_pendingData == data)
+            _pendingData = nil;
+    }
+}
+
+- (void)pmd_setHasChanges:(BOOL)hasChanges
+{
+    _hasChanges = hasChanges;
+    
+    if (_hasChanges)
+        [_persistentStore pmd_didChangePersistentObject:self];
+}
+
+@end
@@ -0,0 +1,74 @@
+//
+//  PMLogObject_Private.h
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import "PMLogObject.h"
+
+/**
+ * Main category extension for private methods.
+ **/
+@interface PMLogObject ()
+
+/**
+ * Offset of the data in the log file. NSNotFound if the object has not been written yet.
+ **/
+@property (nonatomic, assign) NSUInteger dataOffset;
+
+/**
+ * Length of the data in the log file.
+ **/
+@property (nonatomic, assign) NSUInteger dataLength;
+
+/**
+ * Length of the whole record of the object in the log file.
+ **/
+@property (nonatomic, assign) NSUInteger recordLength;
+
+/**
+ * Creation date, as a time interval since 1970.
+ **/
+@property (nonatomic, assign) NSTimeInterval creationTime;
+
+/**
+ * Last recorded access, as a time interval since 1970.
+ **/
+@property (nonatomic, assign) NSTimeInterval accessTime;
+
+/**
+ * Data set since the object was written for the last time, otherwise nil.
+ **/
+- (NSData*)pmd_pendingData;
+
+/**
+ * Releases the pending data once written, unless it has been replaced in the meantime.
+ * @param data The written data.
+ **/
+- (void)pmd_clearPendingData:(NSData*)data;
+
+/**
+ * Use this method to modify the readonly 'hasChanges' property in a 'PMLogObject'.
+ * @param hasChanges Flag indicating if has changes.
+ **/
+- (void)pmd_setHasChanges:(BOOL)hasChanges;
+
+@end
@@ -0,0 +1,80 @@
+//
+//  PMLogStore.h
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import "PMPersistentStore.h"
+
+/**
+ * Append-only, log structured implementation for the PMPersistentStore.
+ *
+ * Every `save` appends to a single log file the records of the changed objects, followed by a commit record, in one sequential write. 
+ * An in-memory index maps each key to the position of its latest record, and data is read from the memory mapped log file without copying it.
+ * Records replaced or deleted are removed by compaction, which rewrites the live records to a new log file in background.
+ * When opening a log, records are replayed up to the last commit record with a valid checksum, discarding any partially written save.
+ *
+ * Access dates are tracked in memory and written within the next record of each object.
+ **/
+@interface PMLogStore : PMPersistentStore
+
+
+/** ---------------------------------------------------------------- **
+ *  @name Creating instances and initializing
+ ** ---------------------------------------------------------------- **/
+
+/**
+ * Default initializer.
+ * @param url The url of the log file. Cannot be nil.
+ * @return The initialized instance.
+ * @discussion If the log file exists, it is replayed to build the index. If it ends with a partially written save, the partial save is discarded.
+ **/
+- (id)initWithURL:(NSURL*)url;
+
+
+/** ---------------------------------------------------------------- **
+ *  @name Compaction
+ ** ---------------------------------------------------------------- **/
+
+/**
+ * Minimum number of bytes of replaced or deleted records to compact the log automatically after a save. Default value is 4MB.
+ * @discussion Compaction is scheduled in background when the dead bytes exceed this threshold and the live bytes of the log.
+ **/
+@property (nonatomic, assign) NSUInteger compactionThreshold;
+
+/**
+ * Size in bytes of the log file.
+ **/
+@property (nonatomic, assign, readonly) NSUInteger logSize;
+
+/**
+ * Size in bytes of the replaced or deleted records in the log file.
+ **/
+@property (nonatomic, assign, readonly) NSUInteger deadSize;
+
+/**
+ * Rewrites the live records into a new log file, removing all replaced or deleted records.
+ * @return YES if the compaction succeeds, otherwise NO.
+ * @discussion Saves and reads are allowed while compacting. This method is executed in the current thread.
+ **/
+- (BOOL)compact;
+
+@end
@@ -0,0 +1,1038 @@
+//
+//  PMLogStore.m
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import "PMLogStore_Private.h"
+
+#import "PMLogObject_Private.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+/**
+ * Magic number starting every record: "PMLR".
+ **/
+static uint32_t const PMLogRecordMagic = 0x524C4D50;
+
+/**
+ * Size of the buffer used to write a compacted log.
+ **/
+static NSUInteger const PMLogStoreCompactionBufferLength = 4 * 1024 * 1024;
+
+typedef enum __PMLogRecordKind
+{
+    PMLogRecordKindPut = 1,
+    PMLogRecordKindDelete = 2,
+    PMLogRecordKindCommit = 3
+} PMLogRecordKind;
+
+/**
+ * Header of a log record, stored in little endian. It is followed by the key, the type, the data and the checksum of the whole record.
+ **/
+typedef struct __PMLogRecordHeader
+{
+    uint32_t magic;
+    uint32_t kind;
+    uint32_t keyLength;
+    uint32_t typeLength;
+    uint64_t dataLength;
+    uint64_t updateTime;
+    uint64_t creationTime;
+    uint64_t accessTime;
+} PMLogRecordHeader;
+
+static NSUInteger const PMLogRecordChecksumLength = sizeof(uint32_t);
+
+static uint32_t checksum(const uint8_t *bytes, NSUInteger length)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    
+    for (NSUInteger i = 0; i < length; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    
+    return hash;
+}
+
+static uint64_t littleEndianFromTime(NSTimeInterval time)
+{
+    uint64_t bits = 0;
+    memcpy(&bits, &time, sizeof(bits));
+    return CFSwapInt64HostToLittle(bits);
+}
+
+static NSTimeInterval timeFromLittleEndian(uint64_t value)
+{
+    uint64_t bits = CFSwapInt64LittleToHost(value);
+    NSTimeInterval time = 0;
+    memcpy(&time, &bits, sizeof(time));
+    return time;
+}
+
+static NSUInteger appendRecord(NSMutableData *buffer, PMLogRecordKind kind, NSString *key, NSString *type, NSData *data, NSTimeInterval updateTime, NSTimeInterval creationTime, NSTimeInterval accessTime)
+{
+    NSData *keyData = [key dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *typeData = [type dataUsingEncoding:NSUTF8StringEncoding];
+    
+    PMLogRecordHeader header;
+    header.magic = CFSwapInt32HostToLittle(PMLogRecordMagic);
+    header.kind = CFSwapInt32HostToLittle(kind);
+    header.keyLength = CFSwapInt32HostToLittle((uint32_t)keyData.length);
+    header.typeLength = CFSwapInt32HostToLittle((uint32_t)typeData.length);
+    header.dataLength = CFSwapInt64HostToLittle(data.length);
+    header.updateTime = littleEndianFromTime(updateTime);
+    header.creationTime = littleEndianFromTime(creationTime);
+    header.accessTime = littleEndianFromTime(accessTime);
+    
+    NSUInteger start = buffer.length;
+    
+    [buffer appendBytes:&header length:sizeof(header)];
+    
+    if (keyData)
+        [buffer appendData:keyData];
+    if (typeData)
+        [buffer appendData:typeData];
+    if (data)
+        [buffer appendData:data];
+    
+    uint32_t sum = CFSwapInt32HostToLittle(checksum((const uint8_t*)buffer.bytes + start, buffer.length - start));
+    [buffer appendBytes:&sum length:sizeof(sum)];
+    
+    return buffer.length - start;
+}
+
+static BOOL writeAll(int fileDescriptor, const uint8_t *bytes, NSUInteger length, NSUInteger offset)
+{
+    NSUInteger written = 0;
+    
+    while (written < length)
+    {
+        ssize_t result = pwrite(fileDescriptor, bytes + written, length - written, (off_t)(offset + written));
+        
+        if (result < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            
+            return NO;
+        }
+        
+        written += result;
+    }
+    
+    return YES;
+}
+
+
+/**
+ * Read only memory mapping of a log file. Data returned by this class keeps the mapping alive.
+ **/
+@interface PMLogMapping : NSObject
+
+- (id)initWithFileDescriptor:(int)fileDescriptor length:(NSUInteger)length;
+
+@property (nonatomic, assign, readonly) const uint8_t *bytes;
+@property (nonatomic, assign, readonly) NSUInteger length;
+
+- (NSData*)dataWithRange:(NSRange)range;
+
+@end
+
+/**
+ * Immutable data backed by a range of a log mapping, which is kept alive as long as the data.
+ * @discussion The mapping is retained by a NSData subclass instead of a deallocator block, available only from iOS 7.
+ **/
+@interface PMLogMappedData : NSData
+
+- (id)initWithMapping:(PMLogMapping*)mapping range:(NSRange)range;
+
+@end
+
+
+@implementation PMLogMapping
+
+- (id)initWithFileDescriptor:(int)fileDescriptor length:(NSUInteger)length
+{
+    self = [super init];
+    if (self)
+    {
+        _bytes = NULL;
+        _length = length;
+        
+        if (length > 0)
+        {
+            void *bytes = mmap(NULL, length, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+            
+            if (bytes == MAP_FAILED)
+                return nil;
+            
+            _bytes = bytes;
+        }
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_bytes)
+        munmap((void*)_bytes, _length);
+}
+
+- (NSData*)dataWithRange:(NSRange)range
+{
+    if (range.length == 0)
+        return [NSData data];
+    
+    return [[PMLogMappedData alloc] initWithMapping:self range:range];
+}
+
+@end
+
+
+@implementation PMLogMappedData
+{
+    PMLogMapping *_mapping;
+    NSRange _range;
+}
+
+- (id)initWithMapping:(PMLogMapping*)mapping range:(NSRange)range
+{
+    self = [super init];
+    if (self)
+    {
+        _mapping = mapping;
+        _range = range;
+    }
+    return self;
+}
+
+- (const void*)bytes
+{
+    return _mapping.bytes + _range.location;
+}
+
+- (NSUInteger)length
+{
+    return _range.length;
+}
+
+@end
+
+
+@implementation PMLogStore
+{
+    NSRecursiveLock *_lock;
+    NSLock *_compactionLock;
+    
+    int _fileDescriptor;
+    NSUInteger _fileLength;
+    NSUInteger _deadLength;
+    PMLogMapping *_mapping;
+    
+    NSMutableDictionary *_objects;
+    NSMutableDictionary *_objectsByType;
+    
+    NSMutableSet *_insertedObjects;
+    NSMutableSet *_updatedObjects;
+    NSMutableSet *_deletedObjects;
+    
+    BOOL _isCompactionScheduled;
+}
+
+- (id)initWithURL:(NSURL*)url
+{
+    if (url == nil)
+    {
+        NSString *reason = @"Cannot create a PMLogStore without the url of its log file.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    self = [super initWithURL:url];
+    if (self)
+    {
+        _lock = [[NSRecursiveLock alloc] init];
+        _compactionLock = [[NSLock alloc] init];
+        
+        _objects = [NSMutableDictionary dictionary];
+        _objectsByType = [NSMutableDictionary dictionary];
+        
+        _insertedObjects = [NSMutableSet set];
+        _updatedObjects = [NSMutableSet set];
+        _deletedObjects = [NSMutableSet set];
+        
+        _compactionThreshold = 4 * 1024 * 1024;
+        _isCompactionScheduled = NO;
+        
+        _fileDescriptor = open([[url path] fileSystemRepresentation], O_RDWR | O_CREAT, 0644);
+        
+        if (_fileDescriptor < 0)
+            return nil;
+        
+        if (![self pmd_replayLog])
+            return nil;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_fileDescriptor >= 0)
+        close(_fileDescriptor);
+}
+
+#pragma mark Properties
+
+- (NSUInteger)logSize
+{
+    [_lock lock];
+    NSUInteger logSize = _fileLength;
+    [_lock unlock];
+    
+    return logSize;
+}
+
+- (NSUInteger)deadSize
+{
+    [_lock lock];
+    NSUInteger deadSize = _deadLength;
+    [_lock unlock];
+    
+    return deadSize;
+}
+
+#pragma mark Super Methods
+
+- (PMLogObject*)persistentObjectWithKey:(NSString*)key
+{
+    if (key == nil)
+    {
+        NSString *reason = @"Cannot query for a persistent object with a nil key.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    [_lock lock];
+    
+    PMLogObject *object = _objects[key];
+    object.accessTime = [[NSDate date] timeIntervalSince1970];
+    
+    [_lock unlock];
+    
+    return object;
+}
+
+- (NSArray*)persistentObjectsOfType:(NSString*)type
+{
+    if (type == nil)
+    {
+        NSString *reason = @"Cannot query for persistent objects with a nil type.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    [_lock lock];
+    
+    NSArray *array = [_objectsByType[type] allValues];
+    
+    NSTimeInterval time = [[NSDate date] timeIntervalSince1970];
+    for (PMLogObject *object in array)
+        object.accessTime = time;
+    
+    [_lock unlock];
+    
+    return array ? array : @[];
+}
+
+- (NSUInteger)countOfObjectsOfType:(NSString*)type
+{
+    if (type == nil)
+    {
+        NSString *reason = @"Cannot count persistent objects with a nil type.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return 0;
+    }
+    
+    [_lock lock];
+    
+    NSUInteger count = [_objectsByType[type] count];
+    
+    [_lock unlock];
+    
+    return count;
+}
+
+- (NSArray*)keysOfType:(NSString*)type updatedSince:(NSDate*)date
+{
+    if (type == nil)
+    {
+        NSString *reason = @"Cannot query for keys with a nil type.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    NSMutableArray *keys = [NSMutableArray array];
+    
+    [_lock lock];
+    
+    // Access dates are not modified.
+    for (PMLogObject *object in [_objectsByType[type] allValues])
+    {
+        if (date == nil || (object.lastUpdate && [object.lastUpdate compare:date] != NSOrderedAscending))
+            [keys addObject:object.key];
+    }
+    
+    [_lock unlock];
+    
+    return keys;
+}
+
+- (NSDate*)lastUpdateForKey:(NSString*)key
+{
+    if (key == nil)
+    {
+        NSString *reason = @"Cannot query for the last update of a nil key.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    [_lock lock];
+    
+    NSDate *lastUpdate = [_objects[key] lastUpdate];
+    
+    [_lock unlock];
+    
+    return lastUpdate;
+}
+
+- (PMLogObject*)createPersistentObjectWithKey:(NSString*)key ofType:(NSString*)type
+{
+    if (key == nil)
+    {
+        NSString *reason = @"Cannot create a persistent object with a nil key.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    else if (type == nil)
+    {
+        NSString *reason = @"Cannot create a persistent object with a nil type.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    [_lock lock];
+    
+    PMLogObject *existingObject = _objects[key];
+    
+    if (existingObject)
+    {
+        [_lock unlock];
+        
+        NSString *reason = @"Cannot create a persitent object because it exists already an object with the given key.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:@{PMPersistentStoreObjectKey: existingObject}];
+        [exception raise];
+        return nil;
+    }
+    
+    NSTimeInterval time = [[NSDate date] timeIntervalSince1970];
+    
+    PMLogObject *object = [[PMLogObject alloc] initWithKey:key andType:type];
+    object.creationTime = time;
+    object.accessTime = time;
+    object.persistentStore = self;
+    
+    [self pmd_addObject:object];
+    [_insertedObjects addObject:object];
+    
+    [_lock unlock];
+    
+    return object;
+}
+
+- (void)deletePersistentObjectWithKey:(NSString*)key
+{
+    if (key == nil)
+    {
+        NSString *reason = @"Cannot delete a persistent object with a nil key.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return;
+    }
+    
+    [_lock lock];
+    
+    PMLogObject *object = _objects[key];
+    
+    if (object)
+    {
+        [self pmd_removeObject:object];
+        
+        // Objects never written don't need a delete record.
+        if ([_insertedObjects containsObject:object])
+        {
+            [_insertedObjects removeObject:object];
+        }
+        else
+        {
+            [_updatedObjects removeObject:object];
+            [_deletedObjects addObject:object];
+        }
+    }
+    
+    [_lock unlock];
+}
+
+- (BOOL)deleteEntriesOfType:(NSString*)type olderThan:(NSDate*)date policy:(PMOptionDelete)option
+{
+    [_lock lock];
+    
+    NSArray *objects = type ? [_objectsByType[type] allValues] : [_objects allValues];
+    NSTimeInterval time = [date timeIntervalSince1970];
+    
+    NSMutableArray *deletedObjects = [NSMutableArray array];
+    
+    for (PMLogObject *object in objects)
+    {
+        if (date)
+        {
+            NSTimeInterval objectTime = 0;
+            
+            switch (option)
+            {
+                case PMOptionDeleteByAccessDate:
+                    objectTime = object.accessTime;
+                    break;
+                    
+                case PMOptionDeleteByCreationDate:
+                    objectTime = object.creationTime;
+                    break;
+                    
+                case PMOptionDeleteByUpdateDate:
+                    objectTime = [object.lastUpdate timeIntervalSince1970];
+                    break;
+            }
+            
+            if (objectTime >= time)
+                continue;
+        }
+        
+        [self pmd_removeObject:object];
+        
+        if ([_insertedObjects containsObject:object])
+        {
+            [_insertedObjects removeObject:object];
+        }
+        else
+        {
+            [_updatedObjects removeObject:object];
+            [deletedObjects addObject:object];
+        }
+    }
+    
+    BOOL succeed = YES;
+    
+    // Deletions are written right away.
+    if (deletedObjects.count > 0)
+        succeed = [self pmd_appendObjects:@[] deletedObjects:deletedObjects];
+    
+    if (!succeed)
+        [_deletedObjects addObjectsFromArray:deletedObjects];
+    
+    [_lock unlock];
+    
+    return succeed;
+}
+
+- (BOOL)save
+{
+    [_lock lock];
+    
+    NSArray *objects = [[_insertedObjects setByAddingObjectsFromSet:_updatedObjects] allObjects];
+    NSArray *deletedObjects = [_deletedObjects allObjects];
+    
+    BOOL succeed = YES;
+    
+    if (objects.count > 0 || deletedObjects.count > 0)
+        succeed = [self pmd_appendObjects:objects deletedObjects:deletedObjects];
+    
+    if (succeed)
+    {
+        [_insertedObjects removeAllObjects];
+        [_updatedObjects removeAllObjects];
+        [_deletedObjects removeAllObjects];
+    }
+    
+    BOOL shouldCompact = succeed && !_isCompactionScheduled && _deadLength >= _compactionThreshold && 2 * _deadLength >= _fileLength;
+    
+    if (shouldCompact)
+        _isCompactionScheduled = YES;
+    
+    [_lock unlock];
+    
+    if (shouldCompact)
+    {
+        __weak PMLogStore *weakSelf = self;
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0), ^{
+            [weakSelf compact];
+        });
+    }
+    
+    return succeed;
+}
+
+#pragma mark Public Methods
+
+- (BOOL)compact
+{
+    [_compactionLock lock];
+    
+    // -- SNAPSHOT OF LIVE RECORDS -- //
+    [_lock lock];
+    
+    NSUInteger snapshotLength = _fileLength;
+    
+    // Deletions not saved yet have no delete record: their committed records must survive the compaction.
+    NSArray *liveObjects = [_objects.allValues arrayByAddingObjectsFromArray:_deletedObjects.allObjects];
+    
+    NSMutableArray *objects = [NSMutableArray arrayWithCapacity:liveObjects.count];
+    NSMutableArray *offsets = [NSMutableArray arrayWithCapacity:liveObjects.count];
+    NSMutableArray *datas = [NSMutableArray arrayWithCapacity:liveObjects.count];
+    NSMutableArray *updateTimes = [NSMutableArray arrayWithCapacity:liveObjects.count];
+    
+    BOOL succeed = YES;
+    
+    for (PMLogObject *object in liveObjects)
+    {
+        if (object.dataOffset == NSNotFound)
+            continue;
+        
+        NSData *data = [self pmd_mappedDataOfObject:object];
+        
+        if (!data)
+        {
+            succeed = NO;
+            break;
+        }
+        
+        [objects addObject:object];
+        [offsets addObject:@(object.dataOffset)];
+        [datas addObject:data];
+        [updateTimes addObject:@([object.lastUpdate timeIntervalSince1970])];
+    }
+    
+    [_lock unlock];
+    
+    // -- LIVE RECORDS ARE WRITTEN INTO A NEW LOG, WITHOUT BLOCKING THE STORE -- //
+    NSString *path = self.url.path;
+    NSString *compactionPath = [path stringByAppendingString:@".compaction"];
+    
+    int fileDescriptor = succeed ? open([compactionPath fileSystemRepresentation], O_RDWR | O_CREAT | O_TRUNC, 0644) : -1;
+    
+    if (fileDescriptor < 0)
+    {
+        [_lock lock];
+        _isCompactionScheduled = NO;
+        [_lock unlock];
+        
+        [_compactionLock unlock];
+        return NO;
+    }
+    
+    NSMutableData *buffer = [NSMutableData data];
+    NSUInteger length = 0;
+    
+    NSMutableArray *newOffsets = [NSMutableArray arrayWithCapacity:objects.count];
+    NSMutableArray *newRecordLengths = [NSMutableArray arrayWithCapacity:objects.count];
+    
+    for (NSUInteger i = 0; i < objects.count && succeed; ++i)
+    {
+        PMLogObject *object = objects[i];
+        NSData *data = datas[i];
+        
+        NSUInteger recordLength = appendRecord(buffer, PMLogRecordKindPut, object.key, object.type, data, [updateTimes[i] doubleValue], object.creationTime, object.accessTime);
+        
+        [newOffsets addObject:@(length + buffer.length - PMLogRecordChecksumLength - data.length)];
+        [newRecordLengths addObject:@(recordLength)];
+        
+        if (buffer.length >= PMLogStoreCompactionBufferLength)
+        {
+            succeed = writeAll(fileDescriptor, buffer.bytes, buffer.length, length);
+            length += buffer.length;
+            buffer.length = 0;
+        }
+    }
+    
+    if (succeed)
+    {
+        appendRecord(buffer, PMLogRecordKindCommit, nil, nil, nil, 0, 0, 0);
+        
+        succeed = writeAll(fileDescriptor, buffer.bytes, buffer.length, length);
+        length += buffer.length;
+    }
+    
+    buffer = nil;
+    datas = nil;
+    
+    // -- RECORDS SAVED MEANWHILE ARE COPIED AND THE NEW LOG REPLACES THE OLD ONE -- //
+    [_lock lock];
+    
+    NSUInteger tailLength = _fileLength - snapshotLength;
+    
+    if (succeed && tailLength > 0)
+    {
+        PMLogMapping *mapping = [self pmd_mappingWithLength:_fileLength];
+        succeed = mapping != nil && writeAll(fileDescriptor, mapping.bytes + snapshotLength, tailLength, length);
+    }
+    
+    succeed = succeed && fsync(fileDescriptor) == 0 && rename([compactionPath fileSystemRepresentation], [path fileSystemRepresentation]) == 0;
+    
+    if (succeed)
+    {
+        NSMutableArray *tailObjects = [NSMutableArray array];
+        
+        for (PMLogObject *object in [_deletedObjects setByAddingObjectsFromArray:_objects.allValues])
+        {
+            if (object.dataOffset != NSNotFound && object.dataOffset >= snapshotLength)
+                [tailObjects addObject:object];
+        }
+        
+        NSUInteger deadLength = 0;
+        
+        for (NSUInteger i = 0; i < objects.count; ++i)
+        {
+            PMLogObject *object = objects[i];
+            
+            // Objects written again or deleted meanwhile keep their newer record.
+            if (object.dataOffset == [offsets[i] unsignedIntegerValue])
+            {
+                object.dataOffset = [newOffsets[i] unsignedIntegerValue];
+                object.recordLength = [newRecordLengths[i] unsignedIntegerValue];
+            }
+            else
+            {
+                deadLength += [newRecordLengths[i] unsignedIntegerValue];
+            }
+        }
+        
+        for (PMLogObject *object in tailObjects)
+            object.dataOffset = object.dataOffset - snapshotLength + length;
+        
+        close(_fileDescriptor);
+        
+        _fileDescriptor = fileDescriptor;
+        _fileLength = length + tailLength;
+        _deadLength = deadLength;
+        _mapping = nil;
+    }
+    else
+    {
+        close(fileDescriptor);
+        unlink([compactionPath fileSystemRepresentation]);
+    }
+    
+    _isCompactionScheduled = NO;
+    
+    [_lock unlock];
+    
+    [_compactionLock unlock];
+    
+    return succeed;
+}
+
+#pragma mark Private Methods
+
+- (void)pmd_didChangePersistentObject:(PMLogObject*)object
+{
+    [_lock lock];
+    
+    // Deleted objects are not written anymore.
+    if (_objects[object.key] == object && ![_insertedObjects containsObject:object])
+        [_updatedObjects addObject:object];
+    
+    [_lock unlock];
+}
+
+- (NSData*)pmd_mappedDataOfObject:(PMLogObject*)object
+{
+    [_lock lock];
+    
+    NSData *data = nil;
+    
+    if (object.dataOffset != NSNotFound)
+    {
+        PMLogMapping *mapping = [self pmd_mappingWithLength:object.dataOffset + object.dataLength];
+        data = [mapping dataWithRange:NSMakeRange(object.dataOffset, object.dataLength)];
+    }
+    
+    [_lock unlock];
+    
+    return data;
+}
+
+- (PMLogMapping*)pmd_mappingWithLength:(NSUInteger)length
+{
+    // The log only grows: a new mapping is needed only to read records appended after the current one.
+    if (!_mapping || _mapping.length < length)
+        _mapping = [[PMLogMapping alloc] initWithFileDescriptor:_fileDescriptor length:_fileLength];
+    
+    return _mapping;
+}
+
+- (BOOL)pmd_appendObjects:(NSArray*)objects deletedObjects:(NSArray*)deletedObjects
+{
+    NSMutableData *batch = [NSMutableData data];
+    
+    NSMutableArray *datas = [NSMutableArray arrayWithCapacity:objects.count];
+    NSMutableArray *recordOffsets = [NSMutableArray arrayWithCapacity:objects.count];
+    NSMutableArray *recordLengths = [NSMutableArray arrayWithCapacity:objects.count];
+    
+    for (PMLogObject *object in objects)
+    {
+        NSData *data = [object pmd_pendingData];
+        
+        if (!data)
+            data = [self pmd_mappedDataOfObject:object];
+        
+        if (!data)
+            data = [NSData data];
+        
+        [datas addObject:data];
+        [recordOffsets addObject:@(batch.length)];
+        [recordLengths addObject:@(appendRecord(batch, PMLogRecordKindPut, object.key, object.type, data, [object.lastUpdate timeIntervalSince1970], object.creationTime, object.accessTime))];
+    }
+    
+    NSUInteger deletionsOffset = batch.length;
+    
+    for (PMLogObject *object in deletedObjects)
+        appendRecord(batch, PMLogRecordKindDelete, object.key, nil, nil, 0, 0, 0);
+    
+    // Records are applied on replay only when followed by a commit record.
+    appendRecord(batch, PMLogRecordKindCommit, nil, nil, nil, 0, 0, 0);
+    
+    if (!writeAll(_fileDescriptor, batch.bytes, batch.length, _fileLength) || fsync(_fileDescriptor) != 0)
+    {
+        ftruncate(_fileDescriptor, (off_t)_fileLength);
+        return NO;
+    }
+    
+    for (NSUInteger i = 0; i < objects.count; ++i)
+    {
+        PMLogObject *object = objects[i];
+        NSData *data = datas[i];
+        NSUInteger recordLength = [recordLengths[i] unsignedIntegerValue];
+        
+        if (object.dataOffset != NSNotFound)
+            _deadLength += object.recordLength;
+        
+        object.dataOffset = _fileLength + [recordOffsets[i] unsignedIntegerValue] + recordLength - PMLogRecordChecksumLength - data.length;
+        object.dataLength = data.length;
+        object.recordLength = recordLength;
+        
+        [object pmd_clearPendingData:data];
+        [object pmd_setHasChanges:NO];
+    }
+    
+    for (PMLogObject *object in deletedObjects)
+    {
+        _deadLength += object.recordLength;
+        
+        object.dataOffset = NSNotFound;
+        object.recordLength = 0;
+    }
+    
+    _deadLength += batch.length - deletionsOffset;
+    _fileLength += batch.length;
+    
+    return YES;
+}
+
+- (BOOL)pmd_replayLog
+{
+    struct stat status;
+    
+    if (fstat(_fileDescriptor, &status) != 0)
+        return NO;
+    
+    NSUInteger length = (NSUInteger)status.st_size;
+    
+    PMLogMapping *mapping = [[PMLogMapping alloc] initWithFileDescriptor:_fileDescriptor length:length];
+    
+    if (!mapping)
+        return NO;
+    
+    const uint8_t *bytes = mapping.bytes;
+    
+    NSUInteger offset = 0;
+    NSUInteger committedLength = 0;
+    
+    NSMutableArray *batch = [NSMutableArray array];
+    NSUInteger batchDeadLength = 0;
+    
+    while (offset + sizeof(PMLogRecordHeader) + PMLogRecordChecksumLength <= length)
+    {
+        PMLogRecordHeader header;
+        memcpy(&header, bytes + offset, sizeof(header));
+        
+        if (CFSwapInt32LittleToHost(header.magic) != PMLogRecordMagic)
+            break;
+        
+        uint32_t kind = CFSwapInt32LittleToHost(header.kind);
+        uint32_t keyLength = CFSwapInt32LittleToHost(header.keyLength);
+        uint32_t typeLength = CFSwapInt32LittleToHost(header.typeLength);
+        uint64_t dataLength = CFSwapInt64LittleToHost(header.dataLength);
+        
+        uint64_t recordLength = sizeof(header) + (uint64_t)keyLength + typeLength + dataLength + PMLogRecordChecksumLength;
+        
+        if (dataLength > length || recordLength > length - offset)
+            break;
+        
+        uint32_t storedChecksum = 0;
+        memcpy(&storedChecksum, bytes + offset + recordLength - PMLogRecordChecksumLength, sizeof(storedChecksum));
+        
+        if (CFSwapInt32LittleToHost(storedChecksum) != checksum(bytes + offset, (NSUInteger)recordLength - PMLogRecordChecksumLength))
+            break;
+        
+        const uint8_t *payload = bytes + offset + sizeof(header);
+        
+        if (kind == PMLogRecordKindPut)
+        {
+            NSString *key = [[NSString alloc] initWithBytes:payload length:keyLength encoding:NSUTF8StringEncoding];
+            NSString *type = [[NSString alloc] initWithBytes:payload + keyLength length:typeLength encoding:NSUTF8StringEncoding];
+            
+            if (!key || !type)
+                break;
+            
+            PMLogObject *object = [[PMLogObject alloc] initWithKey:key andType:type];
+            object.lastUpdate = [NSDate dateWithTimeIntervalSince1970:timeFromLittleEndian(header.updateTime)];
+            object.creationTime = timeFromLittleEndian(header.creationTime);
+            object.accessTime = timeFromLittleEndian(header.accessTime);
+            object.dataOffset = offset + sizeof(header) + keyLength + typeLength;
+            object.dataLength = (NSUInteger)dataLength;
+            object.recordLength = (NSUInteger)recordLength;
+            [object pmd_setHasChanges:NO];
+            
+            [batch addObject:object];
+        }
+        else if (kind == PMLogRecordKindDelete)
+        {
+            NSString *key = [[NSString alloc] initWithBytes:payload length:keyLength encoding:NSUTF8StringEncoding];
+            
+            if (!key)
+                break;
+            
+            [batch addObject:key];
+            batchDeadLength += recordLength;
+        }
+        else if (kind == PMLogRecordKindCommit)
+        {
+            for (id entry in batch)
+            {
+                BOOL isPut = [entry isKindOfClass:[PMLogObject class]];
+                NSString *key = isPut ? [entry key] : entry;
+                
+                PMLogObject *existingObject = _objects[key];
+                
+                if (existingObject)
+                {
+                    _deadLength += existingObject.recordLength;
+                    [self pmd_removeObject:existingObject];
+                }
+                
+                if (isPut)
+                {
+                    [entry setPersistentStore:self];
+                    [self pmd_addObject:entry];
+                }
+            }
+            
+            _deadLength += batchDeadLength + (NSUInteger)recordLength;
+            
+            [batch removeAllObjects];
+            batchDeadLength = 0;
+            
+            committedLength = offset + (NSUInteger)recordLength;
+        }
+        else
+        {
+            break;
+        }
+        
+        offset += (NSUInteger)recordLength;
+    }
+    
+    // Records after the last commit belong to a save that didn't finish: they are discarded.
+    if (committedLength < length)
+    {
+        if (ftruncate(_fileDescriptor, (off_t)committedLength) != 0)
+            return NO;
+        
+        mapping = nil;
+    }
+    
+    _fileLength = committedLength;
+    _mapping = mapping;
+    
+    return YES;
+}
+
+- (void)pmd_addObject:(PMLogObject*)object
+{
+    NSMutableDictionary *objectsOfType = _objectsByType[object.type];
+    
+    if (!objectsOfType)
+    {
+        objectsOfType = [NSMutableDictionary dictionary];
+        _objectsByType[object.type] = objectsOfType;
+    }
+    
+    objectsOfType[object.key] = object;
+    _objects[object.key] = object;
+}
+
+- (void)pmd_removeObject:(PMLogObject*)object
+{
+    NSMutableDictionary *objectsOfType = _objectsByType[object.type];
+    
+    [objectsOfType removeObjectForKey:object.key];
+    
+    if (objectsOfType.count == 0)
+        [_objectsByType removeObjectForKey:object.type];
+    
+    [_objects removeObjectForKey:object.key];
+}
+
+@end
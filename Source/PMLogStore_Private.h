@@ -0,0 +1,48 @@
+//
+//  PMLogStore_Private.h
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import "PMLogStore.h"
+
+@class PMLogObject;
+
+/**
+ * Main category extension for private methods.
+ **/
+@interface PMLogStore ()
+
+/**
+ * Use this method to notify the udpate of a persistent object.
+ * @param object The persistent object.
+ * @discussion PMLogObjects uses this method to notify changes to the persistent store.
+ **/
+- (void)pmd_didChangePersistentObject:(PMLogObject*)object;
+
+/**
+ * Returns the written data of a persistent object.
+ * @param object The persistent object.
+ * @return The data, wrapping the memory mapped log file without copying. Nil if the object has not been written yet.
+ **/
+- (NSData*)pmd_mappedDataOfObject:(PMLogObject*)object;
+
+@end
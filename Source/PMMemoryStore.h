@@ -0,0 +1,54 @@
+//
+//  PMMemoryStore.h
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import "PMPersistentStore.h"
+
+/**
+ * In-memory implementation for the PMPersistentStore.
+ *
+ * Objects are held in hash tables indexed by key and by type, and changes are visible immediately. 
+ * If the store has an url, all objects are loaded from that file when initialized and written to it, in a single sequential write, on every `save`. Otherwise nothing is written and `save` only succeeds.
+ **/
+@interface PMMemoryStore : PMPersistentStore
+
+
+/** ---------------------------------------------------------------- **
+ *  @name Creating instances and initializing
+ ** ---------------------------------------------------------------- **/
+
+/**
+ * Initializes a store without file. Objects are lost when the store is deallocated.
+ * @return The initialized instance.
+ **/
+- (id)init;
+
+/**
+ * Default initializer.
+ * @param url The url of the snapshot file. If nil, the store is not backed by any file.
+ * @return The initialized instance.
+ * @discussion If the file exists, its objects are loaded into memory.
+ **/
+- (id)initWithURL:(NSURL*)url;
+
+@end
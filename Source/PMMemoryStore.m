@@ -0,0 +1,382 @@
+//
+//  PMMemoryStore.m
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import "PMMemoryStore.h"
+
+#import "PMMemoryObject.h"
+
+static NSString * const PMMemoryStoreKeyKey = @"key";
+static NSString * const PMMemoryStoreTypeKey = @"type";
+static NSString * const PMMemoryStoreUpdateDateKey = @"updateDate";
+static NSString * const PMMemoryStoreCreationDateKey = @"creationDate";
+static NSString * const PMMemoryStoreAccessDateKey = @"accessDate";
+static NSString * const PMMemoryStoreDataKey = @"data";
+
+@implementation PMMemoryStore
+{
+    NSLock *_lock;
+    NSMutableDictionary *_objects;
+    NSMutableDictionary *_objectsByType;
+}
+
+- (id)init
+{
+    return [self initWithURL:nil];
+}
+
+- (id)initWithURL:(NSURL*)url
+{
+    self = [super initWithURL:url];
+    if (self)
+    {
+        _lock = [[NSLock alloc] init];
+        _objects = [NSMutableDictionary dictionary];
+        _objectsByType = [NSMutableDictionary dictionary];
+        
+        if (url && [[NSFileManager defaultManager] fileExistsAtPath:[url path]])
+            [self pmd_loadSnapshot];
+    }
+    return self;
+}
+
+#pragma mark Super Methods
+
+- (PMMemoryObject*)persistentObjectWithKey:(NSString*)key
+{
+    if (key == nil)
+    {
+        NSString *reason = @"Cannot query for a persistent object with a nil key.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    [_lock lock];
+    
+    PMMemoryObject *object = _objects[key];
+    object.accessDate = [NSDate date];
+    
+    [_lock unlock];
+    
+    return object;
+}
+
+- (NSArray*)persistentObjectsOfType:(NSString*)type
+{
+    if (type == nil)
+    {
+        NSString *reason = @"Cannot query for persistent objects with a nil type.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    [_lock lock];
+    
+    NSArray *array = [_objectsByType[type] allValues];
+    
+    NSDate *date = [NSDate date];
+    for (PMMemoryObject *object in array)
+        object.accessDate = date;
+    
+    [_lock unlock];
+    
+    return array ? array : @[];
+}
+
+- (NSUInteger)countOfObjectsOfType:(NSString*)type
+{
+    if (type == nil)
+    {
+        NSString *reason = @"Cannot count persistent objects with a nil type.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return 0;
+    }
+    
+    [_lock lock];
+    
+    NSUInteger count = [_objectsByType[type] count];
+    
+    [_lock unlock];
+    
+    return count;
+}
+
+- (NSArray*)keysOfType:(NSString*)type updatedSince:(NSDate*)date
+{
+    if (type == nil)
+    {
+        NSString *reason = @"Cannot query for keys with a nil type.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    NSMutableArray *keys = [NSMutableArray array];
+    
+    [_lock lock];
+    
+    // Access dates are not modified.
+    for (PMMemoryObject *object in [_objectsByType[type] allValues])
+    {
+        if (date == nil || (object.lastUpdate && [object.lastUpdate compare:date] != NSOrderedAscending))
+            [keys addObject:object.key];
+    }
+    
+    [_lock unlock];
+    
+    return keys;
+}
+
+- (NSDate*)lastUpdateForKey:(NSString*)key
+{
+    if (key == nil)
+    {
+        NSString *reason = @"Cannot query for the last update of a nil key.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    [_lock lock];
+    
+    NSDate *lastUpdate = [_objects[key] lastUpdate];
+    
+    [_lock unlock];
+    
+    return lastUpdate;
+}
+
+- (PMMemoryObject*)createPersistentObjectWithKey:(NSString*)key ofType:(NSString*)type
+{
+    if (key == nil)
+    {
+        NSString *reason = @"Cannot create a persistent object with a nil key.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    else if (type == nil)
+    {
+        NSString *reason = @"Cannot create a persistent object with a nil type.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    [_lock lock];
+    
+    PMMemoryObject *existingObject = _objects[key];
+    
+    if (existingObject)
+    {
+        [_lock unlock];
+        
+        NSString *reason = @"Cannot create a persitent object because it exists already an object with the given key.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:@{PMPersistentStoreObjectKey: existingObject}];
+        [exception raise];
+        return nil;
+    }
+    
+    NSDate *date = [NSDate date];
+    
+    PMMemoryObject *object = [[PMMemoryObject alloc] initWithKey:key andType:type];
+    object.creationDate = date;
+    object.accessDate = date;
+    
+    [self pmd_addObject:object];
+    
+    [_lock unlock];
+    
+    return object;
+}
+
+- (void)deletePersistentObjectWithKey:(NSString*)key
+{
+    if (key == nil)
+    {
+        NSString *reason = @"Cannot delete a persistent object with a nil key.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return;
+    }
+    
+    [_lock lock];
+    
+    PMMemoryObject *object = _objects[key];
+    
+    if (object)
+        [self pmd_removeObject:object];
+    
+    [_lock unlock];
+}
+
+- (BOOL)deleteEntriesOfType:(NSString*)type olderThan:(NSDate*)date policy:(PMOptionDelete)option
+{
+    [_lock lock];
+    
+    // Only the objects of the given type are visited.
+    NSArray *objects = type ? [_objectsByType[type] allValues] : [_objects allValues];
+    
+    for (PMMemoryObject *object in objects)
+    {
+        if (date)
+        {
+            NSDate *objectDate = nil;
+            
+            switch (option)
+            {
+                case PMOptionDeleteByAccessDate:
+                    objectDate = object.accessDate;
+                    break;
+                    
+                case PMOptionDeleteByCreationDate:
+                    objectDate = object.creationDate;
+                    break;
+                    
+                case PMOptionDeleteByUpdateDate:
+                    objectDate = object.lastUpdate;
+                    break;
+            }
+            
+            if (!objectDate || [objectDate compare:date] != NSOrderedAscending)
+                continue;
+        }
+        
+        [self pmd_removeObject:object];
+    }
+    
+    [_lock unlock];
+    
+    return YES;
+}
+
+- (BOOL)save
+{
+    if (!self.url)
+        return YES;
+    
+    @synchronized(self)
+    {
+        [_lock lock];
+        
+        NSMutableArray *records = [NSMutableArray arrayWithCapacity:_objects.count];
+        
+        for (PMMemoryObject *object in _objects.objectEnumerator)
+        {
+            NSMutableDictionary *record = [NSMutableDictionary dictionaryWithCapacity:6];
+            
+            record[PMMemoryStoreKeyKey] = object.key;
+            record[PMMemoryStoreTypeKey] = object.type;
+            
+            if (object.lastUpdate)
+                record[PMMemoryStoreUpdateDateKey] = object.lastUpdate;
+            if (object.creationDate)
+                record[PMMemoryStoreCreationDateKey] = object.creationDate;
+            if (object.accessDate)
+                record[PMMemoryStoreAccessDateKey] = object.accessDate;
+            if (object.data)
+                record[PMMemoryStoreDataKey] = object.data;
+            
+            [records addObject:record];
+        }
+        
+        [_lock unlock];
+        
+        NSError *error = nil;
+        NSData *data = [NSPropertyListSerialization dataWithPropertyList:records format:NSPropertyListBinaryFormat_v1_0 options:0 error:&error];
+        
+        if (!data)
+            return NO;
+        
+        return [data writeToURL:self.url options:NSDataWritingAtomic error:&error];
+    }
+}
+
+#pragma mark Private Methods
+
+- (BOOL)pmd_loadSnapshot
+{
+    NSData *data = [NSData dataWithContentsOfURL:self.url];
+    
+    if (!data)
+        return NO;
+    
+    NSArray *records = [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:NULL error:NULL];
+    
+    if (![records isKindOfClass:[NSArray class]])
+        return NO;
+    
+    [_lock lock];
+    
+    for (NSDictionary *record in records)
+    {
+        NSString *key = record[PMMemoryStoreKeyKey];
+        NSString *type = record[PMMemoryStoreTypeKey];
+        
+        if (!key || !type)
+            continue;
+        
+        PMMemoryObject *object = [[PMMemoryObject alloc] initWithKey:key andType:type];
+        object.lastUpdate = record[PMMemoryStoreUpdateDateKey];
+        object.creationDate = record[PMMemoryStoreCreationDateKey];
+        object.accessDate = record[PMMemoryStoreAccessDateKey];
+        object.data = record[PMMemoryStoreDataKey];
+        
+        [self pmd_addObject:object];
+    }
+    
+    [_lock unlock];
+    
+    return YES;
+}
+
+- (void)pmd_addObject:(PMMemoryObject*)object
+{
+    NSMutableDictionary *objectsOfType = _objectsByType[object.type];
+    
+    if (!objectsOfType)
+    {
+        objectsOfType = [NSMutableDictionary dictionary];
+        _objectsByType[object.type] = objectsOfType;
+    }
+    
+    objectsOfType[object.key] = object;
+    _objects[object.key] = object;
+}
+
+- (void)pmd_removeObject:(PMMemoryObject*)object
+{
+    NSMutableDictionary *objectsOfType = _objectsByType[object.type];
+    
+    [objectsOfType removeObjectForKey:object.key];
+    
+    if (objectsOfType.count == 0)
+        [_objectsByType removeObjectForKey:object.type];
+    
+    [_objects removeObjectForKey:object.key];
+}
+
+@end
@@ -0,0 +1,237 @@
+//
+//  PMMetrics.h
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import <Foundation/Foundation.h>
+
+@class PMMetrics;
+
+/** ---------------------------------------------------------------- **
+ *  @name Metric names
+ ** ---------------------------------------------------------------- **/
+
+/**
+ * Histogram of the time spent executing read queries in `PMSQLiteStore`, in seconds.
+ **/
+extern NSString * const PMMetricSQLiteRead;
+
+/**
+ * Histogram of the time spent waiting for a database connection before executing a read query, in seconds.
+ **/
+extern NSString * const PMMetricSQLiteReadWait;
+
+/**
+ * Histogram of the time spent writing a save transaction in `PMSQLiteStore`, in seconds.
+ **/
+extern NSString * const PMMetricSQLiteSave;
+
+/**
+ * Histogram of the time spent waiting for a concurrent save of the same `PMSQLiteStore`, in seconds.
+ **/
+extern NSString * const PMMetricSQLiteSaveWait;
+
+/**
+ * Counter of the bytes of data read from the database.
+ **/
+extern NSString * const PMMetricSQLiteBytesRead;
+
+/**
+ * Counter of the bytes of data written into the database.
+ **/
+extern NSString * const PMMetricSQLiteBytesWritten;
+
+/**
+ * Counter of the persistent object lookups served by a store cache.
+ **/
+extern NSString * const PMMetricCacheHits;
+
+/**
+ * Counter of the persistent object lookups not found in a store cache.
+ **/
+extern NSString * const PMMetricCacheMisses;
+
+/**
+ * Histogram of the time spent encoding an object, in seconds.
+ **/
+extern NSString * const PMMetricContextEncode;
+
+/**
+ * Histogram of the time spent decoding an object, in seconds.
+ **/
+extern NSString * const PMMetricContextDecode;
+
+/**
+ * Histogram of the time spent by a whole context save, in seconds.
+ **/
+extern NSString * const PMMetricContextSave;
+
+/**
+ * Histogram of the time a context save waits since it is requested until it starts, in seconds.
+ **/
+extern NSString * const PMMetricContextSaveWait;
+
+/**
+ * Histogram of the time spent encoding and writing the changed objects during a context save, in seconds.
+ **/
+extern NSString * const PMMetricContextSaveUpdate;
+
+/**
+ * Histogram of the time spent committing the persistent store during a context save, in seconds.
+ **/
+extern NSString * const PMMetricContextSaveCommit;
+
+/**
+ * Histogram of the number of objects saved and deleted by each context save.
+ **/
+extern NSString * const PMMetricContextSavedObjects;
+
+
+/** ---------------------------------------------------------------- **
+ *  @name Recording
+ ** ---------------------------------------------------------------- **/
+
+/**
+ * YES when the shared metrics are enabled. Read by the recording macros before doing any work.
+ **/
+extern volatile BOOL PMMetricsEnabled;
+
+/**
+ * Returns the current time of a monotonic clock, in seconds.
+ **/
+extern NSTimeInterval PMMetricsNow(void);
+
+/**
+ * Increments a counter of the shared metrics, if enabled.
+ **/
+#define PMMetricsIncrement(name, value) do { if (PMMetricsEnabled) [[PMMetrics sharedMetrics] incrementCounter:(name) by:(value)]; } while (0)
+
+/**
+ * Records a value in a histogram of the shared metrics, if enabled.
+ **/
+#define PMMetricsRecord(name, value) do { if (PMMetricsEnabled) [[PMMetrics sharedMetrics] recordValue:(value) forHistogram:(name)]; } while (0)
+
+/**
+ * Returns the start time of a duration, or zero if metrics are disabled.
+ **/
+#define PMMetricsStart() (PMMetricsEnabled ? PMMetricsNow() : 0)
+
+/**
+ * Records the time elapsed since the given start time in a histogram of the shared metrics, if enabled.
+ **/
+#define PMMetricsRecordDuration(name, start) do { if (PMMetricsEnabled && (start) > 0) [[PMMetrics sharedMetrics] recordValue:PMMetricsNow() - (start) forHistogram:(name)]; } while (0)
+
+
+/**
+ * Observer of the metrics, to forward them to a tracing or monitoring system.
+ **/
+@protocol PMMetricsObserver <NSObject>
+
+@optional
+
+/**
+ * Called every time a counter is incremented.
+ * @discussion Observers are called synchronously in the recording thread, from any thread: keep it fast.
+ **/
+- (void)metrics:(PMMetrics*)metrics didIncrementCounter:(NSString*)name by:(int64_t)value;
+
+/**
+ * Called every time a value is recorded in a histogram.
+ * @discussion Observers are called synchronously in the recording thread, from any thread: keep it fast.
+ **/
+- (void)metrics:(PMMetrics*)metrics didRecordValue:(double)value forHistogram:(NSString*)name;
+
+@end
+
+
+/**
+ * Counters and histograms of the time spent and the work done by contexts and stores.
+ *
+ * Metrics are disabled by default. While disabled, every recording point costs a single boolean check.
+ * Metrics can be recorded from any thread: counters are incremented atomically and every histogram has its own lock.
+ **/
+@interface PMMetrics : NSObject
+
+
+/** ---------------------------------------------------------------- **
+ *  @name Getting the metrics
+ ** ---------------------------------------------------------------- **/
+
+/**
+ * The shared metrics, where contexts and stores record.
+ **/
++ (PMMetrics*)sharedMetrics;
+
+/**
+ * Enables or disables the recording of metrics. Default value is NO.
+ **/
+@property (nonatomic, assign, getter = isEnabled) BOOL enabled;
+
+
+/** ---------------------------------------------------------------- **
+ *  @name Recording
+ ** ---------------------------------------------------------------- **/
+
+/**
+ * Increments a counter.
+ * @param name The name of the counter.
+ * @param value The value to add.
+ **/
+- (void)incrementCounter:(NSString*)name by:(int64_t)value;
+
+/**
+ * Records a value in a histogram.
+ * @param value The value to record. Durations are recorded in seconds.
+ * @param name The name of the histogram.
+ * @discussion Values are kept in exponential buckets: percentiles are accurate within 19% (the fourth root of two).
+ **/
+- (void)recordValue:(double)value forHistogram:(NSString*)name;
+
+
+/** ---------------------------------------------------------------- **
+ *  @name Observing and reading
+ ** ---------------------------------------------------------------- **/
+
+/**
+ * Adds an observer. Observers are not retained.
+ * @param observer The observer to add.
+ **/
+- (void)addObserver:(id<PMMetricsObserver>)observer;
+
+/**
+ * Removes an observer.
+ * @param observer The observer to remove.
+ **/
+- (void)removeObserver:(id<PMMetricsObserver>)observer;
+
+/**
+ * Returns the current values of all metrics.
+ * @return A dictionary with the keys "counters", a dictionary of numbers by name, "histograms", a dictionary by name of dictionaries with the keys "count", "sum", "min", "max", "p50", "p90" and "p99", and "cacheHitRatio", computed from the cache counters.
+ **/
+- (NSDictionary*)snapshot;
+
+/**
+ * Clears all counters and histograms.
+ **/
+- (void)reset;
+
+@end
@@ -0,0 +1,398 @@
+//
+//  PMMetrics.m
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import "PMMetrics.h"
+
+#include <math.h>
+
+#if defined(__APPLE__)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+NSString * const PMMetricSQLiteRead = @"sqlite.read";
+NSString * const PMMetricSQLiteReadWait = @"sqlite.read.wait";
+NSString * const PMMetricSQLiteSave = @"sqlite.save";
+NSString * const PMMetricSQLiteSaveWait = @"sqlite.save.wait";
+NSString * const PMMetricSQLiteBytesRead = @"sqlite.bytes.read";
+NSString * const PMMetricSQLiteBytesWritten = @"sqlite.bytes.written";
+NSString * const PMMetricCacheHits = @"cache.hits";
+NSString * const PMMetricCacheMisses = @"cache.misses";
+NSString * const PMMetricContextEncode = @"context.encode";
+NSString * const PMMetricContextDecode = @"context.decode";
+NSString * const PMMetricContextSave = @"context.save";
+NSString * const PMMetricContextSaveWait = @"context.save.wait";
+NSString * const PMMetricContextSaveUpdate = @"context.save.update";
+NSString * const PMMetricContextSaveCommit = @"context.save.commit";
+NSString * const PMMetricContextSavedObjects = @"context.save.objects";
+
+volatile BOOL PMMetricsEnabled = NO;
+
+/**
+ * Number of buckets per power of two of the histograms.
+ **/
+static NSInteger const PMMetricsBucketsPerPowerOfTwo = 4;
+
+/**
+ * Histogram buckets cover from 2^-32 (about 0.2 nanoseconds) to 2^32.
+ **/
+static NSInteger const PMMetricsMinimumExponent = -32;
+static NSInteger const PMMetricsBucketCount = 64 * PMMetricsBucketsPerPowerOfTwo + 1;
+
+NSTimeInterval PMMetricsNow(void)
+{
+#if defined(__APPLE__)
+    // clock_gettime is not available before iOS 10.
+    static double secondsPerTick = 0;
+    
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mach_timebase_info_data_t timebase;
+        mach_timebase_info(&timebase);
+        secondsPerTick = (double)timebase.numer / timebase.denom / 1e9;
+    });
+    
+    return (NSTimeInterval)(mach_absolute_time() * secondsPerTick);
+#else
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    
+    return (NSTimeInterval)time.tv_sec + (NSTimeInterval)time.tv_nsec / 1e9;
+#endif
+}
+
+/**
+ * Counter incremented atomically.
+ **/
+@interface PMMetricsCounter : NSObject
+
+- (void)incrementBy:(int64_t)value;
+- (int64_t)value;
+
+@end
+
+@implementation PMMetricsCounter
+{
+    volatile int64_t _value;
+}
+
+- (void)incrementBy:(int64_t)value
+{
+    __sync_add_and_fetch(&_value, value);
+}
+
+- (int64_t)value
+{
+    return __sync_add_and_fetch(&_value, 0);
+}
+
+@end
+
+/**
+ * Histogram with exponential buckets.
+ **/
+@interface PMMetricsHistogram : NSObject
+
+- (void)recordValue:(double)value;
+- (NSDictionary*)dictionaryRepresentation;
+
+@end
+
+@implementation PMMetricsHistogram
+{
+    NSLock *_lock;
+    uint64_t _count;
+    double _sum;
+    double _min;
+    double _max;
+    uint64_t _buckets[PMMetricsBucketCount];
+}
+
+- (id)init
+{
+    self = [super init];
+    if (self)
+    {
+        _lock = [[NSLock alloc] init];
+    }
+    return self;
+}
+
+- (void)recordValue:(double)value
+{
+    // Bucket 0 holds zero and negative values.
+    NSInteger index = 0;
+    
+    if (value > 0)
+    {
+        double position = (log2(value) - PMMetricsMinimumExponent) * PMMetricsBucketsPerPowerOfTwo;
+        index = MIN(MAX((NSInteger)floor(position), 0), PMMetricsBucketCount - 2) + 1;
+    }
+    
+    [_lock lock];
+    
+    _buckets[index] += 1;
+    _min = _count == 0 ? value : MIN(_min, value);
+    _max = _count == 0 ? value : MAX(_max, value);
+    _sum += value;
+    _count += 1;
+    
+    [_lock unlock];
+}
+
+- (NSDictionary*)dictionaryRepresentation
+{
+    [_lock lock];
+    
+    NSDictionary *dictionary = @{@"count" : @(_count),
+                                 @"sum" : @(_sum),
+                                 @"min" : @(_min),
+                                 @"max" : @(_max),
+                                 @"p50" : @([self pmd_percentile:0.50]),
+                                 @"p90" : @([self pmd_percentile:0.90]),
+                                 @"p99" : @([self pmd_percentile:0.99]),
+                                 };
+    
+    [_lock unlock];
+    
+    return dictionary;
+}
+
+- (double)pmd_percentile:(double)percentile
+{
+    if (_count == 0)
+        return 0;
+    
+    uint64_t rank = (uint64_t)ceil(percentile * _count);
+    uint64_t accumulated = 0;
+    
+    for (NSInteger index = 0; index < PMMetricsBucketCount; ++index)
+    {
+        accumulated += _buckets[index];
+        
+        if (accumulated < rank)
+            continue;
+        
+        if (index == 0)
+            return MIN(_max, 0);
+        
+        // Upper bound of the bucket, clamped to the recorded range.
+        double bound = exp2((double)index / PMMetricsBucketsPerPowerOfTwo + PMMetricsMinimumExponent);
+        return MIN(MAX(bound, _min), _max);
+    }
+    
+    return _max;
+}
+
+@end
+
+
+@interface PMMetrics ()
+
+/**
+ * Counters and histograms by name. Immutable: replaced by a copy when a metric is added, so recording doesn't lock the metrics.
+ **/
+@property (atomic, copy) NSDictionary *counters;
+@property (atomic, copy) NSDictionary *histograms;
+
+@end
+
+@implementation PMMetrics
+{
+    NSLock *_lock;
+    NSHashTable *_observers;
+    volatile BOOL _hasObservers;
+}
+
++ (PMMetrics*)sharedMetrics
+{
+    static PMMetrics *metrics = nil;
+    
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        metrics = [[PMMetrics alloc] init];
+    });
+    
+    return metrics;
+}
+
+- (id)init
+{
+    self = [super init];
+    if (self)
+    {
+        _lock = [[NSLock alloc] init];
+        _counters = @{};
+        _histograms = @{};
+        _observers = [NSHashTable weakObjectsHashTable];
+        _hasObservers = NO;
+    }
+    return self;
+}
+
+#pragma mark Properties
+
+- (BOOL)isEnabled
+{
+    return PMMetricsEnabled;
+}
+
+- (void)setEnabled:(BOOL)enabled
+{
+    PMMetricsEnabled = enabled;
+}
+
+#pragma mark Public Methods
+
+- (void)incrementCounter:(NSString*)name by:(int64_t)value
+{
+    PMMetricsCounter *counter = self.counters[name] ?: [self pmd_counterWithName:name];
+    [counter incrementBy:value];
+    
+    if (!_hasObservers)
+        return;
+    
+    for (id<PMMetricsObserver> observer in [self pmd_observers])
+    {
+        if ([observer respondsToSelector:@selector(metrics:didIncrementCounter:by:)])
+            [observer metrics:self didIncrementCounter:name by:value];
+    }
+}
+
+- (void)recordValue:(double)value forHistogram:(NSString*)name
+{
+    PMMetricsHistogram *histogram = self.histograms[name] ?: [self pmd_histogramWithName:name];
+    [histogram recordValue:value];
+    
+    if (!_hasObservers)
+        return;
+    
+    for (id<PMMetricsObserver> observer in [self pmd_observers])
+    {
+        if ([observer respondsToSelector:@selector(metrics:didRecordValue:forHistogram:)])
+            [observer metrics:self didRecordValue:value forHistogram:name];
+    }
+}
+
+- (void)addObserver:(id<PMMetricsObserver>)observer
+{
+    [_lock lock];
+    [_observers addObject:observer];
+    _hasObservers = _observers.count > 0;
+    [_lock unlock];
+}
+
+- (void)removeObserver:(id<PMMetricsObserver>)observer
+{
+    [_lock lock];
+    [_observers removeObject:observer];
+    _hasObservers = _observers.count > 0;
+    [_lock unlock];
+}
+
+- (NSDictionary*)snapshot
+{
+    NSDictionary *counters = self.counters;
+    NSDictionary *histograms = self.histograms;
+    
+    NSMutableDictionary *counterValues = [NSMutableDictionary dictionaryWithCapacity:counters.count];
+    NSMutableDictionary *histogramValues = [NSMutableDictionary dictionaryWithCapacity:histograms.count];
+    
+    for (NSString *name in counters)
+        counterValues[name] = @([counters[name] value]);
+    
+    for (NSString *name in histograms)
+        histogramValues[name] = [histograms[name] dictionaryRepresentation];
+    
+    double hits = [counterValues[PMMetricCacheHits] doubleValue];
+    double misses = [counterValues[PMMetricCacheMisses] doubleValue];
+    
+    return @{@"counters" : counterValues,
+             @"histograms" : histogramValues,
+             @"cacheHitRatio" : @(hits + misses > 0 ? hits / (hits + misses) : 0),
+             };
+}
+
+- (void)reset
+{
+    // Values recorded concurrently into the replaced metrics are lost.
+    [_lock lock];
+    self.counters = @{};
+    self.histograms = @{};
+    [_lock unlock];
+}
+
+#pragma mark Private Methods
+
+- (PMMetricsCounter*)pmd_counterWithName:(NSString*)name
+{
+    [_lock lock];
+    
+    PMMetricsCounter *counter = self.counters[name];
+    
+    if (!counter)
+    {
+        counter = [[PMMetricsCounter alloc] init];
+        
+        NSMutableDictionary *counters = [self.counters mutableCopy];
+        counters[name] = counter;
+        self.counters = counters;
+    }
+    
+    [_lock unlock];
+    
+    return counter;
+}
+
+- (PMMetricsHistogram*)pmd_histogramWithName:(NSString*)name
+{
+    [_lock lock];
+    
+    PMMetricsHistogram *histogram = self.histograms[name];
+    
+    if (!histogram)
+    {
+        histogram = [[PMMetricsHistogram alloc] init];
+        
+        NSMutableDictionary *histograms = [self.histograms mutableCopy];
+        histograms[name] = histogram;
+        self.histograms = histograms;
+    }
+    
+    [_lock unlock];
+    
+    return histogram;
+}
+
+- (NSArray*)pmd_observers
+{
+    [_lock lock];
+    NSArray *observers = _observers.allObjects;
+    [_lock unlock];
+    
+    return observers;
+}
+
+@end
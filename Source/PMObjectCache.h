@@ -0,0 +1,159 @@
+//
+//  PMObjectCache.h
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Least recently used cache bounded by number of objects and total cost.
+ *
+ * Objects can be pinned to prevent their eviction. Pinned objects are not counted in the limits.
+ * This class is thread safe.
+ **/
+@interface PMObjectCache : NSObject
+
+
+/** ---------------------------------------------------------------- **
+ *  @name Creating instances and initializing
+ ** ---------------------------------------------------------------- **/
+
+/**
+ * Default initializer.
+ * @param countLimit The maximum number of unpinned objects. Zero means no limit.
+ * @param costLimit The maximum total cost of unpinned objects. Zero means no limit.
+ * @return The initialized instance.
+ **/
+- (id)initWithCountLimit:(NSUInteger)countLimit costLimit:(NSUInteger)costLimit;
+
+
+/** ---------------------------------------------------------------- **
+ *  @name Limits
+ ** ---------------------------------------------------------------- **/
+
+/**
+ * The maximum number of unpinned objects. Zero means no limit.
+ **/
+@property (nonatomic, assign) NSUInteger countLimit;
+
+/**
+ * The maximum total cost of unpinned objects. Zero means no limit.
+ **/
+@property (nonatomic, assign) NSUInteger costLimit;
+
+/**
+ * The current number of unpinned objects.
+ **/
+@property (nonatomic, assign, readonly) NSUInteger count;
+
+/**
+ * The current total cost of unpinned objects.
+ **/
+@property (nonatomic, assign, readonly) NSUInteger totalCost;
+
+
+/** ---------------------------------------------------------------- **
+ *  @name Accessing objects
+ ** ---------------------------------------------------------------- **/
+
+/**
+ * Returns the object for the given key and marks it as the most recently used one.
+ * @param key The key. Cannot be nil.
+ * @return The cached object or nil.
+ **/
+- (id)objectForKey:(id)key;
+
+/**
+ * Caches an object. If the cache goes over its limits, the least recently used unpinned objects are evicted.
+ * @param object The object. Cannot be nil.
+ * @param key The key. Cannot be nil.
+ * @param cost The cost of the object, typically its size in bytes.
+ * @discussion If the given key is pinned, the object replaces the pinned one and stays pinned.
+ **/
+- (void)setObject:(id)object forKey:(id)key cost:(NSUInteger)cost;
+
+/**
+ * Caches an object unless there is already an object for the given key.
+ * @param object The object. Cannot be nil.
+ * @param key The key. Cannot be nil.
+ * @param cost The cost of the object, typically its size in bytes.
+ * @return The object already cached for the key, or the given object if it has been cached.
+ * @discussion Use this method to cache objects read outside any lock: a pinned object queued meanwhile is never replaced.
+ **/
+- (id)setObjectIfAbsent:(id)object forKey:(id)key cost:(NSUInteger)cost;
+
+/**
+ * Removes the object for the given key, pinned or not.
+ * @param key The key.
+ **/
+- (void)removeObjectForKey:(id)key;
+
+/**
+ * Removes the objects for the given keys, pinned or not.
+ * @param keys An array of keys.
+ **/
+- (void)removeObjectsForKeys:(NSArray*)keys;
+
+/**
+ * Removes all unpinned objects.
+ **/
+- (void)removeAllObjects;
+
+
+/** ---------------------------------------------------------------- **
+ *  @name Pinning objects
+ ** ---------------------------------------------------------------- **/
+
+/**
+ * Prevents the object for the given key to be evicted.
+ * @param key The key of a cached object. If there is no object for the key, nothing is done.
+ **/
+- (void)pinObjectForKey:(id)key;
+
+/**
+ * Makes the object for the given key evictable again.
+ * @param key The key of a cached object.
+ * @param cost The updated cost of the object.
+ **/
+- (void)unpinObjectForKey:(id)key cost:(NSUInteger)cost;
+
+
+/** ---------------------------------------------------------------- **
+ *  @name Statistics
+ ** ---------------------------------------------------------------- **/
+
+/**
+ * Number of lookups that found an object.
+ **/
+@property (nonatomic, assign, readonly) NSUInteger hitCount;
+
+/**
+ * Number of lookups that didn't find an object.
+ **/
+@property (nonatomic, assign, readonly) NSUInteger missCount;
+
+/**
+ * Number of objects evicted to honor the limits.
+ **/
+@property (nonatomic, assign, readonly) NSUInteger evictionCount;
+
+@end
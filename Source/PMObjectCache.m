@@ -0,0 +1,346 @@
+//
+//  PMObjectCache.m
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import "PMObjectCache.h"
+
+#import "PMMetrics.h"
+
+/**
+ * Node of the recently used list.
+ **/
+@interface PMObjectCacheEntry : NSObject
+
+@property (nonatomic, strong) id key;
+@property (nonatomic, strong) id object;
+@property (nonatomic, assign) NSUInteger cost;
+@property (nonatomic, assign) BOOL pinned;
+
+@property (nonatomic, strong) PMObjectCacheEntry *next;
+@property (nonatomic, unsafe_unretained) PMObjectCacheEntry *previous;
+
+@end
+
+@implementation PMObjectCacheEntry
+@end
+
+
+@implementation PMObjectCache
+{
+    NSLock *_lock;
+    NSMutableDictionary *_entries;
+    
+    // Most recently used entry is the head, least recently used is the tail. Pinned entries are not linked.
+    PMObjectCacheEntry *_head;
+    PMObjectCacheEntry *_tail;
+}
+
+- (id)init
+{
+    return [self initWithCountLimit:0 costLimit:0];
+}
+
+- (id)initWithCountLimit:(NSUInteger)countLimit costLimit:(NSUInteger)costLimit
+{
+    self = [super init];
+    if (self)
+    {
+        _lock = [[NSLock alloc] init];
+        _entries = [NSMutableDictionary dictionary];
+        
+        _countLimit = countLimit;
+        _costLimit = costLimit;
+        
+        _count = 0;
+        _totalCost = 0;
+        
+        _hitCount = 0;
+        _missCount = 0;
+        _evictionCount = 0;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [self removeAllObjects];
+}
+
+#pragma mark Properties
+
+- (void)setCountLimit:(NSUInteger)countLimit
+{
+    [_lock lock];
+    _countLimit = countLimit;
+    [self pmd_evictIfNeeded];
+    [_lock unlock];
+}
+
+- (void)setCostLimit:(NSUInteger)costLimit
+{
+    [_lock lock];
+    _costLimit = costLimit;
+    [self pmd_evictIfNeeded];
+    [_lock unlock];
+}
+
+#pragma mark Public Methods
+
+- (id)objectForKey:(id)key
+{
+    [_lock lock];
+    
+    PMObjectCacheEntry *entry = _entries[key];
+    
+    if (entry)
+    {
+        _hitCount += 1;
+        
+        if (!entry.pinned && entry != _head)
+        {
+            [self pmd_unlinkEntry:entry];
+            [self pmd_linkEntryAtHead:entry];
+        }
+    }
+    else
+    {
+        _missCount += 1;
+    }
+    
+    id object = entry.object;
+    
+    [_lock unlock];
+    
+    if (entry)
+        PMMetricsIncrement(PMMetricCacheHits, 1);
+    else
+        PMMetricsIncrement(PMMetricCacheMisses, 1);
+    
+    return object;
+}
+
+- (void)setObject:(id)object forKey:(id)key cost:(NSUInteger)cost
+{
+    [_lock lock];
+    [self pmd_setObject:object forKey:key cost:cost];
+    [_lock unlock];
+}
+
+- (id)setObjectIfAbsent:(id)object forKey:(id)key cost:(NSUInteger)cost
+{
+    [_lock lock];
+    
+    id cachedObject = [_entries[key] object];
+    
+    if (!cachedObject)
+        [self pmd_setObject:object forKey:key cost:cost];
+    
+    [_lock unlock];
+    
+    return cachedObject ? cachedObject : object;
+}
+
+- (void)removeObjectForKey:(id)key
+{
+    [_lock lock];
+    [self pmd_removeEntryForKey:key];
+    [_lock unlock];
+}
+
+- (void)removeObjectsForKeys:(NSArray*)keys
+{
+    [_lock lock];
+    for (id key in keys)
+        [self pmd_removeEntryForKey:key];
+    [_lock unlock];
+}
+
+- (void)removeAllObjects
+{
+    [_lock lock];
+    
+    PMObjectCacheEntry *entry = _head;
+    while (entry)
+    {
+        [_entries removeObjectForKey:entry.key];
+        
+        // Break the chain one link at a time to avoid a recursive release of the whole list.
+        PMObjectCacheEntry *next = entry.next;
+        entry.next = nil;
+        next.previous = nil;
+        entry = next;
+    }
+    
+    _head = nil;
+    _tail = nil;
+    _count = 0;
+    _totalCost = 0;
+    
+    [_lock unlock];
+}
+
+- (void)pinObjectForKey:(id)key
+{
+    [_lock lock];
+    
+    PMObjectCacheEntry *entry = _entries[key];
+    
+    if (entry && !entry.pinned)
+    {
+        [self pmd_unlinkEntry:entry];
+        entry.pinned = YES;
+        
+        _count -= 1;
+        _totalCost -= entry.cost;
+    }
+    
+    [_lock unlock];
+}
+
+- (void)unpinObjectForKey:(id)key cost:(NSUInteger)cost
+{
+    [_lock lock];
+    
+    PMObjectCacheEntry *entry = _entries[key];
+    
+    if (entry && entry.pinned)
+    {
+        entry.pinned = NO;
+        entry.cost = cost;
+        
+        _count += 1;
+        _totalCost += cost;
+        [self pmd_linkEntryAtHead:entry];
+        
+        [self pmd_evictIfNeeded];
+    }
+    
+    [_lock unlock];
+}
+
+#pragma mark Private Methods
+
+- (void)pmd_setObject:(id)object forKey:(id)key cost:(NSUInteger)cost
+{
+    PMObjectCacheEntry *entry = _entries[key];
+    
+    if (entry)
+    {
+        entry.object = object;
+        
+        if (!entry.pinned)
+        {
+            _totalCost = _totalCost - entry.cost + cost;
+            [self pmd_unlinkEntry:entry];
+            [self pmd_linkEntryAtHead:entry];
+        }
+        
+        entry.cost = cost;
+    }
+    else
+    {
+        entry = [[PMObjectCacheEntry alloc] init];
+        entry.key = key;
+        entry.object = object;
+        entry.cost = cost;
+        entry.pinned = NO;
+        
+        _entries[key] = entry;
+        
+        _count += 1;
+        _totalCost += cost;
+        [self pmd_linkEntryAtHead:entry];
+    }
+    
+    [self pmd_evictIfNeeded];
+}
+
+- (void)pmd_removeEntryForKey:(id)key
+{
+    PMObjectCacheEntry *entry = _entries[key];
+    
+    if (!entry)
+        return;
+    
+    if (!entry.pinned)
+    {
+        _count -= 1;
+        _totalCost -= entry.cost;
+        [self pmd_unlinkEntry:entry];
+    }
+    
+    [_entries removeObjectForKey:key];
+}
+
+- (void)pmd_evictIfNeeded
+{
+    while (_tail && ((_countLimit > 0 && _count > _countLimit) || (_costLimit > 0 && _totalCost > _costLimit)))
+    {
+        PMObjectCacheEntry *entry = _tail;
+        
+        _count -= 1;
+        _totalCost -= entry.cost;
+        [self pmd_unlinkEntry:entry];
+        [_entries removeObjectForKey:entry.key];
+        
+        _evictionCount += 1;
+    }
+}
+
+- (void)pmd_linkEntryAtHead:(PMObjectCacheEntry*)entry
+{
+    entry.previous = nil;
+    entry.next = _head;
+    
+    if (_head)
+        _head.previous = entry;
+    
+    _head = entry;
+    
+    if (!_tail)
+        _tail = entry;
+}
+
+- (void)pmd_unlinkEntry:(PMObjectCacheEntry*)entry
+{
+    // Keep the entry alive while relinking its neighbours.
+    PMObjectCacheEntry *strongEntry = entry;
+    
+    PMObjectCacheEntry *previous = strongEntry.previous;
+    PMObjectCacheEntry *next = strongEntry.next;
+    
+    if (previous)
+        previous.next = next;
+    else if (_head == strongEntry)
+        _head = next;
+    
+    if (next)
+        next.previous = previous;
+    else if (_tail == strongEntry)
+        _tail = previous;
+    
+    strongEntry.next = nil;
+    strongEntry.previous = nil;
+}
+
+@end
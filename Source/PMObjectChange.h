@@ -0,0 +1,63 @@
+//
+//  PMObjectChange.h
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import <Foundation/Foundation.h>
+
+/**
+ * The changes of a persistent object saved by a context.
+ *
+ * Changes are delivered in the 'PMObjectContextDidSaveNotification' notification and applied by `mergeChangesFromContextDidSaveNotification:`.
+ **/
+@interface PMObjectChange : NSObject
+
+/**
+ * Default initializer.
+ * @param key The key of the changed object.
+ * @param changedValues The new values of the changed persistent properties, by property name. Nil values are represented by `NSNull`.
+ * @param lastUpdate The last update of the object.
+ * @param version The version of the save.
+ **/
+- (id)initWithKey:(NSString*)key changedValues:(NSDictionary*)changedValues lastUpdate:(NSDate*)lastUpdate version:(unsigned long long)version;
+
+/**
+ * The key of the changed object.
+ **/
+@property (nonatomic, strong, readonly) NSString *key;
+
+/**
+ * The new values of the changed persistent properties, by property name. Nil values are represented by `NSNull`.
+ **/
+@property (nonatomic, strong, readonly) NSDictionary *changedValues;
+
+/**
+ * The last update of the object.
+ **/
+@property (nonatomic, strong, readonly) NSDate *lastUpdate;
+
+/**
+ * The version of the save. Versions increase with every save of any context of the process, so changes of the same object can be ordered.
+ **/
+@property (nonatomic, assign, readonly) unsigned long long version;
+
+@end
@@ -0,0 +1,51 @@
+//
+//  PMObjectCodec.h
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import <Foundation/Foundation.h>
+
+@class PMBaseObject;
+
+/**
+ * Object codecs are responsible of serializing model objects into the data stored in the persistent objects, and back.
+ * @discussion Contexts decode bulk fetches concurrently: codecs must be thread safe.
+ **/
+@protocol PMObjectCodec <NSObject>
+
+/**
+ * Encodes a model object.
+ * @param object The object to encode. Cannot be nil.
+ * @return The encoded data.
+ **/
+- (NSData*)dataWithObject:(PMBaseObject*)object;
+
+/**
+ * Decodes a model object.
+ * @param objectClass The class of the encoded object, as stored in the persistent object type. Can be nil if unknown.
+ * @param data The encoded data. Cannot be nil.
+ * @return The decoded object or nil if the data cannot be decoded.
+ * @discussion The returned object is not registered in any context and has no key.
+ **/
+- (PMBaseObject*)objectOfClass:(Class)objectClass withData:(NSData*)data;
+
+@end
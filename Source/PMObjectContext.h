@@ -24,12 +24,15 @@
 
 #import <Foundation/Foundation.h>
 
+#import "PMObjectCodec.h"
+#import "PMObjectChange.h"
+#import "PMPersistentStore.h"
+
 @class PMBaseObject;
-@class PMPersistentStore;
 
 /**
  * After a successful save, this notification is posted.
- * UserInfo will contain the keys 'PMObjectContextSavedObjectsKey' and 'PMObjectContextDeletedObjectsKey' to retrieve the saved and deleted objects respectively.
+ * UserInfo will contain the keys 'PMObjectContextSavedObjectsKey' and 'PMObjectContextDeletedObjectsKey' to retrieve the saved and deleted objects respectively, and 'PMObjectContextChangesKey' to retrieve the changes of the saved objects.
  **/
 extern NSString * const PMObjectContextDidSaveNotification;
 
@@ -43,6 +46,11 @@ extern NSString * const PMObjectContextSavedObjectsKey;
  **/
 extern NSString * const PMObjectContextDeletedObjectsKey;
 
+/**
+ * Key to be used in the UserInfo dictionary of the 'PMObjectContextDidSaveNotification' notification to retrieve an array of `PMObjectChange`, one per saved object, with only the changed values.
+ **/
+extern NSString * const PMObjectContextChangesKey;
+
 /**
  * TODO
  **/
@@ -60,6 +68,25 @@ extern NSString * const PMObjectContextDeletedObjectsKey;
 - (id)initWithPersistentStore:(PMPersistentStore*)persistentStore;
 
 
+/** ---------------------------------------------------------------- **
+ *  @name Concurrency
+ ** ---------------------------------------------------------------- **/
+
+/**
+ * Asynchronously performs the given block on the context queue.
+ * @param block The block to perform.
+ * @discussion Each context owns a private serial queue. All methods of the context run on it, so a context can be safely used from any thread. Use this method to group several operations on the context into a single unit of work.
+ **/
+- (void)performBlock:(void (^)())block;
+
+/**
+ * Synchronously performs the given block on the context queue.
+ * @param block The block to perform.
+ * @discussion This method is reentrant: if called from the context queue, the block is performed immediately.
+ **/
+- (void)performBlockAndWait:(void (^)())block;
+
+
 /** ---------------------------------------------------------------- **
  *  @name Registering changes
  ** ---------------------------------------------------------------- **/
@@ -77,12 +104,38 @@ extern NSString * const PMObjectContextDeletedObjectsKey;
 
 /**
  * Returns the object for for the given identifier key.
- * @param key A unique key identifying the object.
+ * @param key A unique key identifying the object. This argument cannot be nil, otherwise a 'NSInvalidArgumentException' exception will be rised.
  * @return The persistent instance associated to the given key.
  * @discussion The method returns the "living instance" of the object if already awaked, otherwase it awakes from the persistence layer the object and returns it. If the object has never been created, returns nil.
  **/
 - (PMBaseObject*)objectForKey:(NSString*)key;
 
+/**
+ * Asynchronously fetches the object for the given identifier key.
+ * @param key A unique key identifying the object. This argument cannot be nil, otherwise a 'NSInvalidArgumentException' exception will be rised in the calling thread.
+ * @param completionQueue The queue where the completion block is called. If nil, the main queue is used.
+ * @param completionBlock The block called with the persistent instance associated to the given key, or nil.
+ * @discussion The store access and decoding are performed on the context queue.
+ **/
+- (void)objectForKey:(NSString*)key completionQueue:(dispatch_queue_t)completionQueue completionBlock:(void (^)(PMBaseObject *object))completionBlock;
+
+/**
+ * Returns the objects for the given identifier keys.
+ * @param keys An array of unique keys identifying the objects.
+ * @return An array with the persistent instances associated to the given keys, in the same order. Keys without object are skipped.
+ * @discussion Living instances are returned directly. All other objects are awaked from the persistence layer at once, which is much faster than calling `objectForKey:` for each key.
+ **/
+- (NSArray*)objectsForKeys:(NSArray*)keys;
+
+/**
+ * Asynchronously fetches the objects for the given identifier keys.
+ * @param keys An array of unique keys identifying the objects.
+ * @param completionQueue The queue where the completion block is called. If nil, the main queue is used.
+ * @param completionBlock The block called with the same array returned by `objectsForKeys:`.
+ * @discussion The store access and decoding are performed on the context queue.
+ **/
+- (void)objectsForKeys:(NSArray*)keys completionQueue:(dispatch_queue_t)completionQueue completionBlock:(void (^)(NSArray *objects))completionBlock;
+
 /**
  * Call this method to check the existence of an object for a given key in the current context (living instances).
  * @param key A unike key identifying the object.
@@ -90,6 +143,12 @@ extern NSString * const PMObjectContextDeletedObjectsKey;
  **/
 - (BOOL)containsObjectWithKey:(NSString*)key;
 
+/**
+ * If YES, the context retains all registered objects. If NO, objects without changes are only referenced weakly. Default value is YES.
+ * @discussion When set to NO, unchanged objects are released as soon as nobody else retains them, and are awaked again from the persistence layer when requested. Changed and deleted objects are retained until saved. While an object is alive, it is the unique instance returned for its key. Use NO for long lived contexts, so memory follows the objects in use instead of all objects ever loaded.
+ **/
+@property (nonatomic, assign) BOOL retainsRegisteredObjects;
+
 /**
  * This method returns all living instances registered on that context.
  * @return An array with all living instances for the current context.
@@ -98,7 +157,7 @@ extern NSString * const PMObjectContextDeletedObjectsKey;
 
 /**
  * Use this method to insert unregistered 'PMBaseObject's into the current context.
- * @param object The object to insert. This argument cannot be nil, otherwise a 'NSInvalidArgumentException' exception will be rised.
+ * @param object The object to insert. This argument and its key cannot be nil, otherwise a 'NSInvalidArgumentException' exception will be rised.
  * @return YES if the object has beeen inserted, NO otherwise.
  * @discussion If there is another object in the context with the same key, the given object won't be inserted into the context and the method will return NO. To persist changes a 'save' is required
  **/
@@ -121,6 +180,18 @@ extern NSString * const PMObjectContextDeletedObjectsKey;
  **/
 @property (nonatomic, strong, readonly) PMPersistentStore *persistentStore;
 
+/**
+ * The codec used to encode and decode objects into the persistent store. Default value is the shared `PMBinaryCodec`.
+ * @discussion The codec must be able to decode the data already stored in the persistent store. `PMBinaryCodec` decodes keyed archives too.
+ **/
+@property (nonatomic, strong) id<PMObjectCodec> codec;
+
+/**
+ * If YES, objects fetched with `objectsOfClass:` are returned as faults. Default value is NO.
+ * @discussion Faults are created from the key, type and last update stored in the persistent store, without reading nor decoding their data. Data is loaded the first time a persistent property is accessed. This is much cheaper when only keys or update dates are needed. Faults must be accessed while the context is alive. Faults need the Apple Objective-C runtime: with other runtimes objects are always loaded.
+ **/
+@property (nonatomic, assign) BOOL returnsObjectsAsFaults;
+
 /**
  * Saves the current context into the persistent store. This method is equivalent to '-saveWithCompletionBlock:' with a NULL block as argument.
  **/
@@ -129,12 +200,19 @@ extern NSString * const PMObjectContextDeletedObjectsKey;
 /**
  * Saves the current context into the persistent store. 
  * @param completionBlock This block is called once the save is finished and contains a parameter 'succeed' to check if the saving has been successful.
- * @discussion This method operates in a background thread (even calling the completion block).
+ * @discussion This method returns immediately. The save is performed on the context queue, where the completion block is called and the 'PMObjectContextDidSaveNotification' is posted. Saves requested before a scheduled save runs are coalesced into it: all changes are saved in a single pass, all completion blocks receive its result and a single notification is posted.
  **/
 - (void)saveWithCompletionBlock:(void (^)(BOOL succeed))completionBlock;
 
+/**
+ * Time interval to wait since a save is requested before performing it. Default value is 0.
+ * @discussion All saves requested during the interval are coalesced into a single save. The interval is not extended by later requests, so changes are saved at most this interval after the first request. Use a small interval (ie. 0.1 seconds) when saving after every change.
+ **/
+@property (nonatomic, assign) NSTimeInterval saveCoalescingInterval;
+
 /**
  * When having multiple contexts operating on the same persistent store, call this method from the 'PMObjectContextDidSaveNotification' posted by other contexts to update the current state of the current context.
+ * @discussion Only the changed values of the saved objects are merged, and only into the objects registered in the context. Deleted objects are unregistered from the context. Merged objects are not marked as changed. Faults only update their last update: they load the saved values when fired. Changes are merged asynchronously on the context queue. Changes older than the last change merged or saved for an object are ignored, so notifications can be merged in any order.
  **/
 - (void)mergeChangesFromContextDidSaveNotification:(NSNotification*)notification;
 
@@ -145,4 +223,79 @@ extern NSString * const PMObjectContextDeletedObjectsKey;
  **/
 - (NSArray*)objectsOfClass:(Class)objectClass;
 
+/**
+ * Asynchronously queries to the persistent store all objects stored of the given class.
+ * @param objectClass The class to retrieve all stored objects.
+ * @param completionQueue The queue where the completion block is called. If nil, the main queue is used.
+ * @param completionBlock The block called with the same array returned by `objectsOfClass:`.
+ * @discussion The store access and decoding are performed on the context queue.
+ **/
+- (void)objectsOfClass:(Class)objectClass completionQueue:(dispatch_queue_t)completionQueue completionBlock:(void (^)(NSArray *objects))completionBlock;
+
+/**
+ * Queries to the persistent store and returns a page of the objects stored of the given class.
+ * @param objectClass The class to retrieve the stored objects.
+ * @param offset The number of objects to skip.
+ * @param limit The maximum number of objects to return.
+ * @param order The order of the objects.
+ * @return An array with the instances of the specified class in the given range.
+ * @discussion Returned objects are registered in the context as in `objectsOfClass:`.
+ **/
+- (NSArray*)objectsOfClass:(Class)objectClass offset:(NSUInteger)offset limit:(NSUInteger)limit order:(PMOptionOrder)order;
+
+/**
+ * Enumerates in batches all objects stored of the given class, sorted by key.
+ * @param objectClass The class to enumerate all stored objects.
+ * @param batchSize The number of objects of each batch.
+ * @param block The block called for each batch. Set `stop` to YES to stop the enumeration.
+ * @discussion Only one batch is kept in memory at a time. Batches are fetched on the context queue and the block is called in the calling thread. Living instances are returned when registered in the context, other objects are not registered and are released after the block returns. Only saved objects are enumerated.
+ **/
+- (void)enumerateObjectsOfClass:(Class)objectClass batchSize:(NSUInteger)batchSize usingBlock:(void (^)(NSArray *objects, BOOL *stop))block;
+
+
+/** ---------------------------------------------------------------- **
+ *  @name Querying metadata
+ ** ---------------------------------------------------------------- **/
+
+/**
+ * Counts the objects stored of the given class.
+ * @param objectClass The class to count the stored objects.
+ * @return The number of stored instances of the specified class.
+ * @discussion Objects are not loaded, decoded nor registered in the context. Only saved objects are counted.
+ **/
+- (NSUInteger)countOfObjectsOfClass:(Class)objectClass;
+
+/**
+ * Queries the keys of the objects stored of the given class updated since the given date.
+ * @param objectClass The class of the stored objects.
+ * @param date Objects whose last update is equal or later than this date are returned. If nil, the keys of all stored objects of the class are returned.
+ * @return An array with the keys, in no particular order.
+ * @discussion Objects are not loaded, decoded nor registered in the context. Only saved changes are considered. Use it to sync incrementally: keep the date of the previous query and fetch only the returned keys with `objectsForKeys:`.
+ **/
+- (NSArray*)keysOfClass:(Class)objectClass updatedSince:(NSDate*)date;
+
+/**
+ * Returns the last update of the object stored with the given key.
+ * @param key The object key. Cannot be nil.
+ * @return The last saved update of the object, or nil if there is no stored object with the given key.
+ * @discussion The object is not loaded, decoded nor registered in the context. Unsaved changes of living instances are not considered.
+ **/
+- (NSDate*)lastUpdateForKey:(NSString*)key;
+
+
+/** ---------------------------------------------------------------- **
+ *  @name Importing objects
+ ** ---------------------------------------------------------------- **/
+
+/**
+ * Creates or updates objects of the given class from dictionaries (ie. parsed from JSON) and saves them into the persistent store.
+ * @param objectClass The class of the objects to import. Must be a subclass of `PMBaseObject`.
+ * @param dictionaries A collection or enumerator of dictionaries. Values are set via KVC with `setValuesForKeysWithDictionary:`. Entries not named as a persistent property are ignored, and `NSNull` values are set as nil to object properties and ignored for scalar properties. Elements other than dictionaries are skipped.
+ * @param keyAttribute The name of the dictionary entry containing the key of each object. Numbers are converted to strings. Dictionaries without key are skipped. The entry is used only as the object key: it is not set as a value. This argument cannot be nil, otherwise a 'NSInvalidArgumentException' exception will be rised.
+ * @param batchSize The number of dictionaries processed and saved at once.
+ * @return YES if all batches have been saved, NO otherwise.
+ * @discussion Dictionaries are processed in batches: existing objects are fetched at once, values are set, changed objects are encoded concurrently and saved in a single store transaction. Objects whose values don't change are not written. Only one batch is kept in memory at a time. Living instances are updated, other objects are not registered into the context. A 'PMObjectContextDidSaveNotification' is posted for every saved batch. The import stops at the first batch failing to save.
+ **/
+- (BOOL)importObjectsOfClass:(Class)objectClass fromDictionaries:(id<NSFastEnumeration>)dictionaries keyAttribute:(NSString*)keyAttribute batchSize:(NSUInteger)batchSize;
+
 @end
@@ -22,25 +22,54 @@
 // OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
 // SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
 
-#import "PMObjectContext.h"
+#import "PMObjectContext_Private.h"
 
 #import "PMBaseObject+PrivateMethods.h"
 #import "PMPersistentObject.h"
 #import "PMPersistentStore.h"
+#import "PMBinaryCodec.h"
+#import "PMMetrics.h"
+
+#import <objc/runtime.h>
 
 NSString * const PMObjectContextDidSaveNotification = @"PMObjectContextDidSaveNotification";
 NSString * const PMObjectContextSavedObjectsKey = @"PMObjectContextSavedObjectsKey";
 NSString * const PMObjectContextDeletedObjectsKey = @"PMObjectContextDeletedObjectsKey";
+NSString * const PMObjectContextChangesKey = @"PMObjectContextChangesKey";
+
+/**
+ * Version of the last save of any context.
+ **/
+static volatile int64_t PMObjectContextSaveVersion = 0;
+
+/**
+ * Minimum number of objects to decode concurrently. Smaller fetches are decoded in the calling thread.
+ **/
+static NSUInteger const PMObjectContextConcurrentDecodingThreshold = 64;
+
+/**
+ * Number of objects decoded by each concurrent iteration.
+ **/
+static NSUInteger const PMObjectContextConcurrentDecodingStride = 16;
+
+/**
+ * Key used to tag the context queues, in order to detect reentrant calls.
+ **/
+static char PMObjectContextQueueKey;
 
 @implementation PMObjectContext
 {
-    NSMutableDictionary *_objects;
+    NSMapTable *_objects;
     NSMutableSet *_deletedObjects;
+    NSMutableSet *_changedObjects;
+    NSMapTable *_objectVersions;
     BOOL _hasChanges;
     
-    BOOL _isSaving;
-    NSCondition *_savingCondition;
-    NSInteger _savingOperationIndex;
+    dispatch_queue_t _queue;
+    
+    NSMutableArray *_pendingSaveCompletionBlocks;
+    BOOL _isSaveScheduled;
+    NSTimeInterval _saveRequestTime;
 }
 
 - (id)initWithPersistentStore:(PMPersistentStore *)persistentStore
@@ -51,10 +80,18 @@ NSString * const PMObjectContextDeletedObjectsKey = @"PMObjectContextDeletedObje
         _persistentStore = persistentStore;
         
         _hasChanges = NO;
-        _isSaving = NO;
-        _savingCondition = [[NSCondition alloc] init];
-        _objects = [NSMutableDictionary dictionary];
+        _queue = dispatch_queue_create("com.persistentmodel.objectcontext", DISPATCH_QUEUE_SERIAL);
+        dispatch_queue_set_specific(_queue, &PMObjectContextQueueKey, (__bridge void*)self, NULL);
+        _retainsRegisteredObjects = YES;
+        _objects = [self pmd_objectsMapTable];
         _deletedObjects = [NSMutableSet set];
+        _changedObjects = [NSMutableSet set];
+        _objectVersions = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsWeakMemory | NSPointerFunctionsObjectPointerPersonality
+                                                valueOptions:NSPointerFunctionsStrongMemory];
+        _pendingSaveCompletionBlocks = [NSMutableArray array];
+        _isSaveScheduled = NO;
+        _saveCoalescingInterval = 0;
+        _codec = [PMBinaryCodec defaultCodec];
     }
     return self;
 }
@@ -63,40 +100,177 @@ NSString * const PMObjectContextDeletedObjectsKey = @"PMObjectContextDeletedObje
 
 - (BOOL)hasChanges
 {
-    if (_hasChanges)
-        return YES;
+    __block BOOL hasChanges = NO;
     
-    NSArray *allObjects = _objects.allValues;
+    [self performBlockAndWait:^{
+        hasChanges = _hasChanges || _changedObjects.count > 0;
+    }];
     
-    for (PMBaseObject *object in allObjects)
-    {
-        if (object.hasChanges)
-            return YES;
-    }
-    
-    return NO;
+    return hasChanges;
+}
+
+- (void)setRetainsRegisteredObjects:(BOOL)retainsRegisteredObjects
+{
+    [self performBlockAndWait:^{
+        if (_retainsRegisteredObjects == retainsRegisteredObjects)
+            return;
+        
+        _retainsRegisteredObjects = retainsRegisteredObjects;
+        
+        NSMapTable *objects = [self pmd_objectsMapTable];
+        
+        for (NSString *key in _objects)
+        {
+            PMBaseObject *object = [_objects objectForKey:key];
+            
+            if (object)
+                [objects setObject:object forKey:key];
+        }
+        
+        _objects = objects;
+    }];
 }
 
 #pragma mark Public Methods
 
+- (void)performBlock:(void (^)())block
+{
+    if (block == nil)
+        return;
+    
+    dispatch_async(_queue, block);
+}
+
+- (void)performBlockAndWait:(void (^)())block
+{
+    if (block == nil)
+        return;
+    
+    if (dispatch_get_specific(&PMObjectContextQueueKey) == (__bridge void*)self)
+        block();
+    else
+        dispatch_sync(_queue, block);
+}
+
 - (PMBaseObject*)objectForKey:(NSString*)key
-{    
-    PMBaseObject* object = [_objects valueForKey:key];
+{
+    // Exceptions can't unwind through the context queue: arguments are validated in the calling thread.
+    if (key == nil)
+    {
+        NSString *reason = @"Cannot query for an object with a nil key.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
     
-    if (!object)
-        object = [self pmd_baseObjectFromPersistentStoreWithKey:key];
+    __block PMBaseObject *object = nil;
+    
+    [self performBlockAndWait:^{
+        object = [_objects objectForKey:key];
+        
+        if (!object)
+            object = [self pmd_baseObjectFromPersistentStoreWithKey:key];
+    }];
     
     return object;
 }
 
+- (void)objectForKey:(NSString*)key completionQueue:(dispatch_queue_t)completionQueue completionBlock:(void (^)(PMBaseObject *object))completionBlock
+{
+    if (key == nil)
+    {
+        NSString *reason = @"Cannot query for an object with a nil key.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return;
+    }
+    
+    [self performBlock:^{
+        PMBaseObject *object = [self objectForKey:key];
+        
+        if (completionBlock)
+        {
+            dispatch_async(completionQueue ?: dispatch_get_main_queue(), ^{
+                completionBlock(object);
+            });
+        }
+    }];
+}
+
+- (NSArray*)objectsForKeys:(NSArray*)keys
+{
+    __block NSMutableArray *array = nil;
+    
+    [self performBlockAndWait:^{
+        NSMutableDictionary *objects = [NSMutableDictionary dictionaryWithCapacity:keys.count];
+        NSMutableArray *missingKeys = [NSMutableArray array];
+        
+        for (NSString *key in keys)
+        {
+            PMBaseObject *object = [_objects objectForKey:key];
+            
+            if (object)
+                objects[key] = object;
+            else
+                [missingKeys addObject:key];
+        }
+        
+        if (missingKeys.count > 0)
+        {
+            NSArray *result = [_persistentStore persistentObjectsWithKeys:missingKeys];
+            
+            for (PMBaseObject *baseObject in [self pmd_baseObjectsFromModelObjects:result registering:YES])
+                objects[baseObject.key] = baseObject;
+        }
+        
+        array = [NSMutableArray arrayWithCapacity:objects.count];
+        
+        for (NSString *key in keys)
+        {
+            PMBaseObject *object = objects[key];
+            
+            if (object)
+                [array addObject:object];
+        }
+    }];
+    
+    return array;
+}
+
+- (void)objectsForKeys:(NSArray*)keys completionQueue:(dispatch_queue_t)completionQueue completionBlock:(void (^)(NSArray *objects))completionBlock
+{
+    [self performBlock:^{
+        NSArray *objects = [self objectsForKeys:keys];
+        
+        if (completionBlock)
+        {
+            dispatch_async(completionQueue ?: dispatch_get_main_queue(), ^{
+                completionBlock(objects);
+            });
+        }
+    }];
+}
+
 - (BOOL)containsObjectWithKey:(NSString*)key
 {
-    return [_objects valueForKey:key] != nil;
+    __block BOOL contains = NO;
+    
+    [self performBlockAndWait:^{
+        contains = [_objects objectForKey:key] != nil;
+    }];
+    
+    return contains;
 }
 
 - (NSArray*)registeredObjects
 {
-    return _objects.allValues;
+    __block NSArray *objects = nil;
+    
+    [self performBlockAndWait:^{
+        objects = _objects.objectEnumerator.allObjects;
+    }];
+    
+    return objects;
 }
 
 - (BOOL)insertObject:(PMBaseObject*)object
@@ -109,12 +283,30 @@ NSString * const PMObjectContextDeletedObjectsKey = @"PMObjectContextDeletedObje
         return NO;
     }
     
-    if ([self containsObjectWithKey:object.key])
+    if (object.key == nil)
+    {
+        NSString *reason = @"You cannot insert an object without key into a context.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
         return NO;
+    }
     
-    _hasChanges = YES;
-    [_objects setValue:object forKey:object.key];
-    return YES;
+    __block BOOL inserted = NO;
+    
+    [self performBlockAndWait:^{
+        if ([_objects objectForKey:object.key] != nil)
+            return;
+        
+        _hasChanges = YES;
+        [_objects setObject:object forKey:object.key];
+        
+        if (object.hasChanges)
+            [_changedObjects addObject:object];
+        
+        inserted = YES;
+    }];
+    
+    return inserted;
 }
 
 - (void)deleteObject:(PMBaseObject*)object
@@ -127,13 +319,16 @@ NSString * const PMObjectContextDeletedObjectsKey = @"PMObjectContextDeletedObje
         return;
     }
     
-    if ([_objects.allValues containsObject:object])
-    {
-        _hasChanges = YES;
-        [_objects removeObjectForKey:object.key];
-        [_deletedObjects addObject:object];
-        [object deleteObjectFromContext];
-    }
+    [self performBlockAndWait:^{
+        if ([_objects objectForKey:object.key] == object)
+        {
+            _hasChanges = YES;
+            [_objects removeObjectForKey:object.key];
+            [_changedObjects removeObject:object];
+            [_deletedObjects addObject:object];
+            [object deleteObjectFromContext];
+        }
+    }];
 }
 
 - (void)save
@@ -143,151 +338,665 @@ NSString * const PMObjectContextDeletedObjectsKey = @"PMObjectContextDeletedObje
 
 - (void)saveWithCompletionBlock:(void (^)(BOOL succeed))completionBlock
 {
-    void (^saveBlock)() = ^{
-        _savingOperationIndex += 1;
-        NSInteger currentOperationIndex = _savingOperationIndex;
-        
-        [_savingCondition lock];
-        
-        while (_isSaving)
-            [_savingCondition wait];
+    [self performBlock:^{
+        if (completionBlock)
+            [_pendingSaveCompletionBlocks addObject:[completionBlock copy]];
         
-        _isSaving = YES;
+        // Requests received before the scheduled save runs are coalesced into it.
+        if (_isSaveScheduled)
+            return;
         
-        BOOL shouldSaveCoreDataContext = _hasChanges;
+        _isSaveScheduled = YES;
+        _saveRequestTime = PMMetricsStart();
         
-        // -- SAVED OBJECTS -- //
-        NSMutableSet *savedObjects = [NSMutableSet set];
-        NSArray *allValues = [_objects.allValues copy];
-        for (PMBaseObject *object in allValues)
+        if (_saveCoalescingInterval > 0)
         {
-            if (object.hasChanges)
-            {
-                shouldSaveCoreDataContext = YES;
-                [self pmd_updatePersistentModelObjectOfBaseObject:object];
-                object.hasChanges = NO;
-                [savedObjects addObject:object];
-            }
+            dispatch_time_t time = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(_saveCoalescingInterval * NSEC_PER_SEC));
+            dispatch_after(time, _queue, ^{
+                [self pmd_performPendingSave];
+            });
+        }
+        else
+        {
+            dispatch_async(_queue, ^{
+                [self pmd_performPendingSave];
+            });
+        }
+    }];
+}
+
+- (void)mergeChangesFromContextDidSaveNotification:(NSNotification*)notification
+{
+    PMObjectContext *savedContext = notification.object;
+    
+    // If it is the same context, nothing to do
+    if (savedContext == self)
+        return;
+    
+    // If both context doesn't share the same persistent store, nothing to do
+    if (savedContext.persistentStore != _persistentStore && _persistentStore != nil)
+        return;
+    
+//    // If both context doesn't share the same persistent store url, nothing to do
+//    if (![[savedContext.persistentStore.url path] isEqualToString:[_persistentStore.url path]])
+//        return;
+    
+    // Changes are immutable snapshots taken by the saving context: they can be applied later on this context queue.
+    NSArray *changes = [notification.userInfo valueForKey:PMObjectContextChangesKey];
+    NSSet *deletedObjects = [notification.userInfo valueForKey:PMObjectContextDeletedObjectsKey];
+    
+    NSMutableArray *deletedKeys = [NSMutableArray arrayWithCapacity:deletedObjects.count];
+    
+    for (PMBaseObject *object in deletedObjects)
+        [deletedKeys addObject:object.key];
+    
+    if (changes.count == 0 && deletedKeys.count == 0)
+        return;
+    
+    // Merging asynchronously avoids deadlocks between contexts merging each other's saves.
+    [self performBlock:^{
+        for (PMObjectChange *change in changes)
+        {
+            PMBaseObject *myObject = [_objects objectForKey:change.key];
+            
+            if (!myObject)
+                continue;
+            
+            // Notifications may be merged out of order: a change older than the last one applied or saved is stale.
+            if (change.version <= [[_objectVersions objectForKey:myObject] unsignedLongLongValue])
+                continue;
+            
+            [_objectVersions setObject:@(change.version) forKey:myObject];
+            [myObject pmd_setLastUpdate:change.lastUpdate];
+            
+            // Faults will load the saved values from the shared persistent store
+            if (myObject.isFault)
+                continue;
+            
+            [change.changedValues enumerateKeysAndObjectsUsingBlock:^(NSString *key, id value, BOOL *stop) {
+                [myObject pmd_setPersistentValue:(value == [NSNull null] ? nil : value) forKey:key];
+            }];
         }
         
-        // -- DELETED OBJECTS -- //
-        NSSet *deletedObjects = [_deletedObjects copy];
-        shouldSaveCoreDataContext |= deletedObjects.count > 0;
-        for (PMBaseObject *object in deletedObjects)
-            [_persistentStore deletePersistentObjectWithKey:object.key];
+        for (NSString *key in deletedKeys)
+        {
+            PMBaseObject *myObject = [_objects objectForKey:key];
+            
+            if (!myObject)
+                continue;
+            
+            [_objects removeObjectForKey:key];
+            [_changedObjects removeObject:myObject];
+            [myObject pmd_detachFromContext];
+        }
+    }];
+}
+
+- (NSArray*)objectsOfClass:(Class)objectClass
+{
+    if (![objectClass isSubclassOfClass:[PMBaseObject  class]])
+        return @[];
+    
+    __block NSArray *objects = nil;
+    
+    BOOL returnsFaults = _returnsObjectsAsFaults && PMBaseObjectSupportsFaults;
+    
+    [self performBlockAndWait:^{
+        NSArray *result = [_persistentStore persistentObjectsOfType:NSStringFromClass(objectClass) includesData:!returnsFaults];
         
-        BOOL succeed = NO;
-        if (shouldSaveCoreDataContext)
-            succeed = [_persistentStore save];
+        if (!returnsFaults)
+        {
+            objects = [self pmd_baseObjectsFromModelObjects:result registering:YES];
+            return;
+        }
         
-        if (succeed)
-            [_deletedObjects removeAllObjects];
+        NSMutableArray *array = [NSMutableArray array];
         
-        _hasChanges = NO;
+        for (id <PMPersistentObject> mo in result)
+        {
+            PMBaseObject *baseObject = [_objects objectForKey:mo.key];
+            
+            if (!baseObject)
+            {
+                baseObject = [self pmd_faultFromModelObject:mo];
+                
+                if (!baseObject)
+                    continue;
+                
+                baseObject.hasChanges = NO;
+                [self insertObject:baseObject];
+            }
+            
+            [array addObject:baseObject];
+        }
         
-        _isSaving = NO;
-        [_savingCondition signal];
-        [_savingCondition unlock];
+        objects = array;
+    }];
+    
+    return objects;
+}
+
+- (void)objectsOfClass:(Class)objectClass completionQueue:(dispatch_queue_t)completionQueue completionBlock:(void (^)(NSArray *objects))completionBlock
+{
+    [self performBlock:^{
+        NSArray *objects = [self objectsOfClass:objectClass];
         
         if (completionBlock)
-            completionBlock(succeed);
-        
-        if (currentOperationIndex == _savingOperationIndex)
         {
-            NSMutableDictionary *dict = [NSMutableDictionary dictionary];
+            dispatch_async(completionQueue ?: dispatch_get_main_queue(), ^{
+                completionBlock(objects);
+            });
+        }
+    }];
+}
+
+- (NSArray*)objectsOfClass:(Class)objectClass offset:(NSUInteger)offset limit:(NSUInteger)limit order:(PMOptionOrder)order
+{
+    if (![objectClass isSubclassOfClass:[PMBaseObject  class]])
+        return @[];
+    
+    __block NSArray *objects = nil;
+    
+    [self performBlockAndWait:^{
+        NSArray *result = [_persistentStore persistentObjectsOfType:NSStringFromClass(objectClass) offset:offset limit:limit order:order];
+        objects = [self pmd_baseObjectsFromModelObjects:result registering:YES];
+    }];
+    
+    return objects;
+}
+
+- (void)enumerateObjectsOfClass:(Class)objectClass batchSize:(NSUInteger)batchSize usingBlock:(void (^)(NSArray *objects, BOOL *stop))block
+{
+    if (block == nil)
+    {
+        NSString *reason = @"Cannot enumerate objects with a nil block.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return;
+    }
+    
+    if (![objectClass isSubclassOfClass:[PMBaseObject  class]])
+        return;
+    
+    NSString *type = NSStringFromClass(objectClass);
+    NSString *lastKey = nil;
+    
+    batchSize = MAX(batchSize, 1);
+    
+    BOOL stop = NO;
+    
+    while (!stop)
+    {
+        @autoreleasepool
+        {
+            // Each batch is fetched on the context queue, the block is called in the caller thread.
+            __block NSArray *result = nil;
+            __block NSArray *objects = nil;
+            
+            [self performBlockAndWait:^{
+                result = [_persistentStore persistentObjectsOfType:type afterKey:lastKey limit:batchSize];
+                objects = [self pmd_baseObjectsFromModelObjects:result registering:NO];
+            }];
             
-            if (savedObjects.count > 0)
-                [dict setValuesForKeysWithDictionary:@{PMObjectContextSavedObjectsKey : savedObjects}];
-            if (deletedObjects.count > 0)
-                [dict setValuesForKeysWithDictionary:@{PMObjectContextDeletedObjectsKey : deletedObjects}];
+            if (result.count == 0)
+                break;
             
-            NSNotification *notification = [NSNotification notificationWithName:PMObjectContextDidSaveNotification
-                                                                         object:self
-                                                                       userInfo:dict];
+            lastKey = [result.lastObject key];
             
-            [[NSNotificationCenter defaultCenter] postNotification:notification];
+            block(objects, &stop);
+            
+            if (result.count < batchSize)
+                stop = YES;
         }
-    };
+    }
+}
+
+- (NSUInteger)countOfObjectsOfClass:(Class)objectClass
+{
+    if (![objectClass isSubclassOfClass:[PMBaseObject  class]])
+        return 0;
     
-    if ([NSThread isMainThread])
+    __block NSUInteger count = 0;
+    
+    [self performBlockAndWait:^{
+        count = [_persistentStore countOfObjectsOfType:NSStringFromClass(objectClass)];
+    }];
+    
+    return count;
+}
+
+- (NSArray*)keysOfClass:(Class)objectClass updatedSince:(NSDate*)date
+{
+    if (![objectClass isSubclassOfClass:[PMBaseObject  class]])
+        return @[];
+    
+    __block NSArray *keys = nil;
+    
+    [self performBlockAndWait:^{
+        keys = [_persistentStore keysOfType:NSStringFromClass(objectClass) updatedSince:date];
+    }];
+    
+    return keys;
+}
+
+- (NSDate*)lastUpdateForKey:(NSString*)key
+{
+    if (key == nil)
     {
-        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-            saveBlock();
-        });
+        NSString *reason = @"Cannot query for the last update of a nil key.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
     }
-    else
+    
+    __block NSDate *lastUpdate = nil;
+    
+    [self performBlockAndWait:^{
+        lastUpdate = [_persistentStore lastUpdateForKey:key];
+    }];
+    
+    return lastUpdate;
+}
+
+- (BOOL)importObjectsOfClass:(Class)objectClass fromDictionaries:(id<NSFastEnumeration>)dictionaries keyAttribute:(NSString*)keyAttribute batchSize:(NSUInteger)batchSize
+{
+    if (keyAttribute == nil)
     {
-        saveBlock();
+        NSString *reason = @"Cannot import objects with a nil key attribute.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return NO;
     }
+    
+    if (![objectClass isSubclassOfClass:[PMBaseObject  class]])
+        return NO;
+    
+    batchSize = MAX(batchSize, 1);
+    
+    __block BOOL succeed = YES;
+    NSMutableArray *batch = [NSMutableArray arrayWithCapacity:batchSize];
+    
+    void (^importBlock)() = ^{
+        @autoreleasepool
+        {
+            [self performBlockAndWait:^{
+                succeed = [self pmd_importDictionaries:batch ofClass:objectClass keyAttribute:keyAttribute];
+            }];
+            
+            [batch removeAllObjects];
+        }
+    };
+    
+    for (NSDictionary *dictionary in dictionaries)
+    {
+        [batch addObject:dictionary];
+        
+        if (batch.count < batchSize)
+            continue;
+        
+        importBlock();
+        
+        if (!succeed)
+            return NO;
+    }
+    
+    if (batch.count > 0)
+        importBlock();
+    
+    return succeed;
 }
 
-- (void)mergeChangesFromContextDidSaveNotification:(NSNotification*)notification
+#pragma mark Private Methods
+
+- (NSMapTable*)pmd_objectsMapTable
 {
-    PMObjectContext *savedContext = notification.object;
+    // Changed and deleted objects are retained by their own sets until saved.
+    if (_retainsRegisteredObjects)
+        return [NSMapTable strongToStrongObjectsMapTable];
     
-    // If it is the same context, nothing to do
-    if (savedContext == self)
+    return [NSMapTable strongToWeakObjectsMapTable];
+}
+
+- (void)pmd_didChangeBaseObject:(PMBaseObject*)object
+{
+    [self performBlockAndWait:^{
+        if ([_objects objectForKey:object.key] == object)
+            [_changedObjects addObject:object];
+    }];
+}
+
+- (void)pmd_didClearChangesOfBaseObject:(PMBaseObject*)object
+{
+    [self performBlockAndWait:^{
+        [_changedObjects removeObject:object];
+    }];
+}
+
+- (void)pmd_fireFaultOfBaseObject:(PMBaseObject*)object
+{
+    __block id<PMPersistentObject> modelObject = nil;
+    
+    [self performBlockAndWait:^{
+        modelObject = [_persistentStore persistentObjectWithKey:object.key];
+    }];
+    
+    NSData *data = modelObject.data;
+    
+    if (!data)
         return;
     
-    // If both context doesn't share the same persistent store, nothing to do
-    if (savedContext.persistentStore != _persistentStore && _persistentStore != nil)
+    NSTimeInterval decodeStart = PMMetricsStart();
+    PMBaseObject *values = [_codec objectOfClass:object.class withData:data];
+    PMMetricsRecordDuration(PMMetricContextDecode, decodeStart);
+    
+    if (values)
+        [object pmd_setPersistentValuesWithObject:values];
+    else
+        [self pmd_reportUndecodableModelObject:modelObject];
+}
+
+- (void)pmd_reportUndecodableModelObject:(id<PMPersistentObject>)modelObject
+{
+    PMPersistentStore *persistentStore = _persistentStore;
+    
+    if (!persistentStore)
         return;
     
-//    // If both context doesn't share the same persistent store url, nothing to do
-//    if (![[savedContext.persistentStore.url path] isEqualToString:[_persistentStore.url path]])
-//        return;
+    NSString *reason = [NSString stringWithFormat:@"Cannot decode the data of the object with key %@ as %@.", modelObject.key, modelObject.type];
+    NSError *error = [NSError errorWithDomain:PMPersistentStoreErrorDomain code:PMPersistentStoreErrorCodeCorruptedData userInfo:@{NSLocalizedFailureReasonErrorKey : reason}];
     
-    NSArray *savedObjects = [notification.userInfo valueForKey:PMObjectContextSavedObjectsKey];
+    // Objects are decoded on the context queue, maybe concurrently: observers are notified out of it.
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [[NSNotificationCenter defaultCenter] postNotificationName:PMPersistentStoreDidFailNotification
+                                                            object:persistentStore
+                                                          userInfo:@{PMPersistentStoreErrorKey : error, PMPersistentStoreObjectKey : modelObject}];
+    });
+}
+
+/**
+ * Performs a single save pass for all save requests received since the last one. Must be called on the context queue.
+ **/
+- (void)pmd_performPendingSave
+{
+    NSArray *completionBlocks = [_pendingSaveCompletionBlocks copy];
+    [_pendingSaveCompletionBlocks removeAllObjects];
+    _isSaveScheduled = NO;
     
-    for (PMBaseObject *object in savedObjects)
+    PMMetricsRecordDuration(PMMetricContextSaveWait, _saveRequestTime);
+    
+    NSTimeInterval saveStart = PMMetricsStart();
+    
+    BOOL shouldSaveCoreDataContext = _hasChanges;
+    
+    // -- SAVED OBJECTS -- //
+    NSTimeInterval updateStart = PMMetricsStart();
+    
+    unsigned long long version = (unsigned long long)__sync_add_and_fetch(&PMObjectContextSaveVersion, 1);
+    
+    NSMutableSet *savedObjects = [NSMutableSet set];
+    NSMutableArray *changes = [NSMutableArray array];
+    NSSet *changedObjects = [_changedObjects copy];
+    for (PMBaseObject *object in changedObjects)
     {
-        PMBaseObject *myObject = [_objects valueForKey:object.key];
-        
-        if (myObject)
-        {
-            NSDictionary *keyedValues = [object dictionaryWithValuesForKeys:[object.class pmd_allPersistentPropertyNames]];
-            
-            [myObject setValuesForKeysWithDictionary:keyedValues];
-            myObject.hasChanges = NO;
-            myObject.lastUpdate = object.lastUpdate;
-        }
+        shouldSaveCoreDataContext = YES;
+        [self pmd_updatePersistentModelObjectOfBaseObject:object];
+        [changes addObject:[self pmd_changeOfBaseObject:object version:version]];
+        object.hasChanges = NO;
+        [savedObjects addObject:object];
     }
+    
+    PMMetricsRecordDuration(PMMetricContextSaveUpdate, updateStart);
+    
+    // -- DELETED OBJECTS -- //
+    NSSet *deletedObjects = [_deletedObjects copy];
+    shouldSaveCoreDataContext |= deletedObjects.count > 0;
+    for (PMBaseObject *object in deletedObjects)
+        [_persistentStore deletePersistentObjectWithKey:object.key];
+    
+    NSTimeInterval commitStart = PMMetricsStart();
+    
+    BOOL succeed = NO;
+    if (shouldSaveCoreDataContext)
+        succeed = [_persistentStore save];
+    
+    PMMetricsRecordDuration(PMMetricContextSaveCommit, commitStart);
+    
+    if (succeed)
+        [_deletedObjects removeAllObjects];
+    
+    _hasChanges = NO;
+    
+    PMMetricsRecordDuration(PMMetricContextSave, saveStart);
+    PMMetricsRecord(PMMetricContextSavedObjects, savedObjects.count + deletedObjects.count);
+    
+    for (void (^completionBlock)(BOOL succeed) in completionBlocks)
+        completionBlock(succeed);
+    
+    if (!succeed)
+        return;
+    
+    NSMutableDictionary *dict = [NSMutableDictionary dictionary];
+    
+    if (savedObjects.count > 0)
+        [dict setValuesForKeysWithDictionary:@{PMObjectContextSavedObjectsKey : savedObjects, PMObjectContextChangesKey : changes}];
+    if (deletedObjects.count > 0)
+        [dict setValuesForKeysWithDictionary:@{PMObjectContextDeletedObjectsKey : deletedObjects}];
+    
+    NSNotification *notification = [NSNotification notificationWithName:PMObjectContextDidSaveNotification
+                                                                 object:self
+                                                               userInfo:dict];
+    
+    [[NSNotificationCenter defaultCenter] postNotification:notification];
 }
 
-- (NSArray*)objectsOfClass:(Class)objectClass
+/**
+ * Imports a batch of dictionaries and saves the persistent store. Must be called on the context queue.
+ **/
+- (BOOL)pmd_importDictionaries:(NSArray*)dictionaries ofClass:(Class)objectClass keyAttribute:(NSString*)keyAttribute
 {
-    if (![objectClass isSubclassOfClass:[PMBaseObject  class]])
-        return @[];
+    NSString *type = NSStringFromClass(objectClass);
+    
+    // KVC exceptions can't unwind through the context queue: only persistent properties are set, and nulls only to object properties.
+    NSSet *propertyNames = [objectClass pmd_allPersistentPropertyNameSet];
+    NSMutableSet *objectPropertyNames = [NSMutableSet setWithCapacity:propertyNames.count];
+    
+    for (NSString *name in propertyNames)
+    {
+        objc_property_t property = class_getProperty(objectClass, name.UTF8String);
+        const char *attributes = property ? property_getAttributes(property) : NULL;
+        
+        if (attributes && strncmp(attributes, "T@", 2) == 0)
+            [objectPropertyNames addObject:name];
+    }
+    
+    // -- KEYS -- //
+    NSMutableDictionary *valuesByKey = [NSMutableDictionary dictionaryWithCapacity:dictionaries.count];
+    NSMutableArray *keys = [NSMutableArray arrayWithCapacity:dictionaries.count];
+    
+    for (NSDictionary *dictionary in dictionaries)
+    {
+        if (![dictionary isKindOfClass:[NSDictionary class]])
+            continue;
+        
+        id key = dictionary[keyAttribute];
+        
+        if ([key isKindOfClass:[NSNumber class]])
+            key = [key stringValue];
+        
+        if (![key isKindOfClass:[NSString class]])
+            continue;
+        
+        // Later dictionaries override earlier ones with the same key.
+        if (!valuesByKey[key])
+            [keys addObject:key];
+        
+        // The key is only set from its normalized string: the key attribute entry may be a number or named as a persistent property.
+        NSMutableDictionary *values = [NSMutableDictionary dictionaryWithCapacity:dictionary.count];
+        
+        [dictionary enumerateKeysAndObjectsUsingBlock:^(NSString *name, id value, BOOL *stop) {
+            if (![propertyNames containsObject:name] || [name isEqual:keyAttribute])
+                return;
+            
+            // `setValuesForKeysWithDictionary:` sets nulls as nil, which scalars don't accept.
+            if (value == [NSNull null] && ![objectPropertyNames containsObject:name])
+                return;
+            
+            values[name] = value;
+        }];
+        
+        valuesByKey[key] = values;
+    }
+    
+    // -- EXISTING OBJECTS -- //
+    NSMutableDictionary *objects = [NSMutableDictionary dictionaryWithCapacity:keys.count];
+    NSMutableDictionary *modelObjects = [NSMutableDictionary dictionary];
+    NSMutableArray *missingKeys = [NSMutableArray array];
+    
+    for (NSString *key in keys)
+    {
+        PMBaseObject *object = [_objects objectForKey:key];
+        
+        if (object)
+            objects[key] = object;
+        else
+            [missingKeys addObject:key];
+    }
     
-    NSArray *result = [_persistentStore persistentObjectsOfType:NSStringFromClass(objectClass)];
+    if (missingKeys.count > 0)
+    {
+        NSArray *result = [_persistentStore persistentObjectsWithKeys:missingKeys];
+        NSArray *decodedObjects = [self pmd_unregisteredBaseObjectsFromModelObjects:result];
+        
+        [result enumerateObjectsUsingBlock:^(id<PMPersistentObject> mo, NSUInteger idx, BOOL *stop) {
+            modelObjects[mo.key] = mo;
+            
+            if (decodedObjects[idx] != [NSNull null])
+                objects[mo.key] = decodedObjects[idx];
+        }];
+    }
     
-    NSMutableArray *array = [NSMutableArray array];
+    // -- UPSERT -- //
+    NSMutableArray *changedObjects = [NSMutableArray arrayWithCapacity:keys.count];
     
-    for (id <PMPersistentObject> mo in result)
+    for (NSString *key in keys)
     {
-        PMBaseObject *baseObject = [_objects valueForKey:mo.key];
+        id<PMPersistentObject> mo = modelObjects[key];
+        
+        // Objects stored with another type are not overwritten.
+        if (mo && ![mo.type isEqualToString:type])
+            continue;
+        
+        PMBaseObject *object = objects[key];
+        
+        if (object && ![object isKindOfClass:objectClass])
+            continue;
+        
+        BOOL isNew = object == nil;
+        
+        if (isNew)
+            object = [[objectClass alloc] initWithKey:key context:nil];
+        
+        [object setValuesForKeysWithDictionary:valuesByKey[key]];
+        
+        if (isNew || object.hasChanges)
+            [changedObjects addObject:object];
+    }
+    
+    if (changedObjects.count == 0)
+        return YES;
+    
+    // -- ENCODING -- //
+    NSUInteger count = changedObjects.count;
+    NSUInteger stride = PMObjectContextConcurrentDecodingStride;
+    size_t iterations = (count + stride - 1) / stride;
+    
+    __strong NSData **buffer = (__strong NSData **)calloc(count, sizeof(NSData*));
+    
+    void (^encodeBlock)(size_t) = ^(size_t iteration) {
+        NSUInteger end = MIN((iteration + 1) * stride, count);
         
-        if (!baseObject)
+        for (NSUInteger index = iteration * stride; index < end; ++index)
         {
-            baseObject = [self pmd_baseObjectFromModelObject:mo];
-            baseObject.hasChanges = NO;
-            [self insertObject:baseObject];
+            @autoreleasepool
+            {
+                NSTimeInterval encodeStart = PMMetricsStart();
+                buffer[index] = [_codec dataWithObject:changedObjects[index]];
+                PMMetricsRecordDuration(PMMetricContextEncode, encodeStart);
+            }
         }
+    };
+    
+    if (count < PMObjectContextConcurrentDecodingThreshold)
+    {
+        for (size_t iteration = 0; iteration < iterations; ++iteration)
+            encodeBlock(iteration);
+    }
+    else
+    {
+        dispatch_apply(iterations, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), encodeBlock);
+    }
+    
+    // -- WRITING -- //
+    NSMutableSet *savedObjects = [NSMutableSet setWithCapacity:count];
+    
+    for (NSUInteger index = 0; index < count; ++index)
+    {
+        PMBaseObject *object = changedObjects[index];
+        NSData *data = buffer[index];
+        buffer[index] = nil;
+        
+        if (!data)
+            continue;
+        
+        id<PMPersistentObject> mo = modelObjects[object.key];
         
-        [array addObject:baseObject];
+        if (!mo)
+            mo = [_persistentStore createPersistentObjectWithKey:object.key ofType:type];
+        
+        mo.lastUpdate = object.lastUpdate;
+        mo.data = data;
+        
+        [savedObjects addObject:object];
     }
     
-    return array;
+    free(buffer);
+    
+    if (![_persistentStore save])
+        return NO;
+    
+    unsigned long long version = (unsigned long long)__sync_add_and_fetch(&PMObjectContextSaveVersion, 1);
+    NSMutableArray *changes = [NSMutableArray arrayWithCapacity:savedObjects.count];
+    
+    for (PMBaseObject *object in savedObjects)
+    {
+        [changes addObject:[self pmd_changeOfBaseObject:object version:version]];
+        object.hasChanges = NO;
+    }
+    
+    NSNotification *notification = [NSNotification notificationWithName:PMObjectContextDidSaveNotification
+                                                                 object:self
+                                                               userInfo:@{PMObjectContextSavedObjectsKey : savedObjects, PMObjectContextChangesKey : changes}];
+    
+    [[NSNotificationCenter defaultCenter] postNotification:notification];
+    
+    return YES;
 }
 
-#pragma mark Private Methods
+- (PMObjectChange*)pmd_changeOfBaseObject:(PMBaseObject*)baseObject version:(unsigned long long)version
+{
+    [_objectVersions setObject:@(version) forKey:baseObject];
+    
+    return [[PMObjectChange alloc] initWithKey:baseObject.key
+                                 changedValues:[baseObject pmd_changedPersistentValues]
+                                    lastUpdate:baseObject.lastUpdate
+                                       version:version];
+}
 
 - (void)pmd_updatePersistentModelObjectOfBaseObject:(PMBaseObject*)baseObject
-{    
-    NSMutableData *data = [NSMutableData data];
-    NSKeyedArchiver *archiver = [[NSKeyedArchiver alloc] initForWritingWithMutableData:data];
-    [archiver encodeRootObject:baseObject];
-    [archiver finishEncoding];
+{
+    NSTimeInterval encodeStart = PMMetricsStart();
+    NSData *data = [_codec dataWithObject:baseObject];
+    PMMetricsRecordDuration(PMMetricContextEncode, encodeStart);
     
     id<PMPersistentObject> object = [_persistentStore persistentObjectWithKey:baseObject.key];
     
@@ -305,8 +1014,12 @@ NSString * const PMObjectContextDeletedObjectsKey = @"PMObjectContextDeletedObje
     if (object)
     {
         PMBaseObject *baseObject = [self pmd_baseObjectFromModelObject:object];
-        baseObject.hasChanges = NO;
-        [self insertObject:baseObject];
+        
+        if (baseObject)
+        {
+            baseObject.hasChanges = NO;
+            [self insertObject:baseObject];
+        }
 
         return baseObject;
     }
@@ -314,19 +1027,145 @@ NSString * const PMObjectContextDeletedObjectsKey = @"PMObjectContextDeletedObje
     return nil;
 }
 
+- (PMBaseObject*)pmd_faultFromModelObject:(id<PMPersistentObject>)modelObject
+{
+    Class objectClass = NSClassFromString(modelObject.type);
+    
+    if (![objectClass isSubclassOfClass:PMBaseObject.class])
+        return nil;
+    
+    PMBaseObject *baseObject = [[objectClass alloc] initWithKey:modelObject.key context:nil];
+    [baseObject pmd_turnIntoFault];
+    [baseObject registerToContext:self];
+    baseObject.lastUpdate = modelObject.lastUpdate;
+    
+    return baseObject;
+}
+
 - (PMBaseObject*)pmd_baseObjectFromModelObject:(id<PMPersistentObject>)modelObject
+{
+    PMBaseObject *baseObject = [self pmd_unregisteredBaseObjectFromModelObject:modelObject];
+    
+    [baseObject registerToContext:self];
+    
+    return baseObject;
+}
+
+- (NSArray*)pmd_baseObjectsFromModelObjects:(NSArray*)modelObjects registering:(BOOL)registering
+{
+    NSMutableArray *objects = [NSMutableArray arrayWithCapacity:modelObjects.count];
+    NSMutableArray *unregisteredModelObjects = [NSMutableArray array];
+    
+    for (id <PMPersistentObject> mo in modelObjects)
+    {
+        PMBaseObject *baseObject = [_objects objectForKey:mo.key];
+        
+        if (baseObject)
+        {
+            [objects addObject:baseObject];
+        }
+        else
+        {
+            [objects addObject:[NSNull null]];
+            [unregisteredModelObjects addObject:mo];
+        }
+    }
+    
+    NSArray *decodedObjects = [self pmd_unregisteredBaseObjectsFromModelObjects:unregisteredModelObjects];
+    NSUInteger decodedIndex = 0;
+    
+    NSMutableArray *array = [NSMutableArray arrayWithCapacity:objects.count];
+    
+    // Registration is serial and keeps the order of the model objects.
+    for (id object in objects)
+    {
+        PMBaseObject *baseObject = object;
+        
+        if (object == [NSNull null])
+        {
+            baseObject = decodedObjects[decodedIndex++];
+            
+            if ((id)baseObject == [NSNull null])
+                continue;
+            
+            if (registering && ![baseObject registerToContext:self])
+                baseObject = [_objects objectForKey:baseObject.key];
+        }
+        
+        if (baseObject)
+            [array addObject:baseObject];
+    }
+    
+    return array;
+}
+
+- (NSArray*)pmd_unregisteredBaseObjectsFromModelObjects:(NSArray*)modelObjects
+{
+    NSUInteger count = modelObjects.count;
+    NSUInteger stride = PMObjectContextConcurrentDecodingStride;
+    size_t iterations = (count + stride - 1) / stride;
+    
+    __strong PMBaseObject **buffer = (__strong PMBaseObject **)calloc(count, sizeof(PMBaseObject*));
+    
+    void (^decodeBlock)(size_t) = ^(size_t iteration) {
+        NSUInteger end = MIN((iteration + 1) * stride, count);
+        
+        for (NSUInteger index = iteration * stride; index < end; ++index)
+        {
+            @autoreleasepool
+            {
+                buffer[index] = [self pmd_unregisteredBaseObjectFromModelObject:modelObjects[index]];
+            }
+        }
+    };
+    
+    // Decoding is the most expensive part of bulk fetches: it runs in all cores.
+    if (count < PMObjectContextConcurrentDecodingThreshold)
+    {
+        for (size_t iteration = 0; iteration < iterations; ++iteration)
+            decodeBlock(iteration);
+    }
+    else
+    {
+        dispatch_apply(iterations, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), decodeBlock);
+    }
+    
+    NSMutableArray *array = [NSMutableArray arrayWithCapacity:count];
+    
+    for (NSUInteger index = 0; index < count; ++index)
+    {
+        [array addObject:(buffer[index] ? (id)buffer[index] : [NSNull null])];
+        buffer[index] = nil;
+    }
+    
+    free(buffer);
+    
+    return array;
+}
+
+- (PMBaseObject*)pmd_unregisteredBaseObjectFromModelObject:(id<PMPersistentObject>)modelObject
 {    
     NSAssert(modelObject != nil, @"ModelObject should not be nil");
     NSAssert(modelObject.key != nil, @"Model Object of type %@ has a key == ", modelObject.type, modelObject.key);
     
     NSData *data = modelObject.data;
     
-    NSKeyedUnarchiver *unarchiver = [[NSKeyedUnarchiver alloc] initForReadingWithData:data];
+    if (!data)
+        return nil;
+    
+    NSTimeInterval decodeStart = PMMetricsStart();
+    PMBaseObject *baseObject = [_codec objectOfClass:NSClassFromString(modelObject.type) withData:data];
+    PMMetricsRecordDuration(PMMetricContextDecode, decodeStart);
+    
+    if (!baseObject)
+    {
+        [self pmd_reportUndecodableModelObject:modelObject];
+        return nil;
+    }
     
-    PMBaseObject *baseObject = [unarchiver decodeObject];
     baseObject.key = modelObject.key;
-    [baseObject registerToContext:self];
     baseObject.lastUpdate = modelObject.lastUpdate;
+    baseObject.hasChanges = NO;
     
     return baseObject;
 }
@@ -0,0 +1,53 @@
+//
+//  PMObjectContext_Private.h
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import "PMObjectContext.h"
+
+/**
+ * Main category extension for private methods.
+ **/
+@interface PMObjectContext ()
+
+/**
+ * Use this method to notify that a registered object has changes.
+ * @param object The base object.
+ * @discussion PMBaseObjects use this method to notify the context when their 'hasChanges' flag becomes YES.
+ **/
+- (void)pmd_didChangeBaseObject:(PMBaseObject*)object;
+
+/**
+ * Use this method to notify that a registered object has no more changes.
+ * @param object The base object.
+ * @discussion PMBaseObjects use this method to notify the context when their 'hasChanges' flag becomes NO.
+ **/
+- (void)pmd_didClearChangesOfBaseObject:(PMBaseObject*)object;
+
+/**
+ * Loads from the persistent store the persistent values of a fault.
+ * @param object The base object, which has just stopped being a fault.
+ * @discussion If the object is not found in the persistent store, values are left untouched.
+ **/
+- (void)pmd_fireFaultOfBaseObject:(PMBaseObject*)object;
+
+@end
@@ -47,12 +47,60 @@ typedef enum __PMOptionDelete
     PMOptionDeleteByUpdateDate
 } PMOptionDelete;
 
+/**
+ * Ordering options for paged queries.
+ **/
+typedef enum __PMOptionOrder
+{
+    /**
+     * Order by ascending key.
+     **/
+    PMOptionOrderByKey,
+    
+    /**
+     * Order by ascending update date, then by key.
+     **/
+    PMOptionOrderByUpdateDate
+} PMOptionOrder;
+
 
 /**
  * This value is used as Key in NSException and NSNotifications userInfo dictionary.
  **/
 extern NSString * const PMPersistentStoreObjectKey;
 
+/**
+ * Notification posted when a persistent object of a store cannot be saved, read or decoded. It is posted by the store, or by the context decoding the object. The notification object is the store.
+ * @discussion The userInfo dictionary contains the error, with the key `PMPersistentStoreErrorKey`, and the persistent object if known, with the key `PMPersistentStoreObjectKey`. The notification may be posted in any thread.
+ **/
+extern NSString * const PMPersistentStoreDidFailNotification;
+
+/**
+ * Key of the error in the userInfo dictionary of the 'PMPersistentStoreDidFailNotification' notification.
+ **/
+extern NSString * const PMPersistentStoreErrorKey;
+
+/**
+ * Domain of the errors reported by stores.
+ **/
+extern NSString * const PMPersistentStoreErrorDomain;
+
+/**
+ * Codes of the errors reported by stores.
+ **/
+typedef enum __PMPersistentStoreErrorCode
+{
+    /**
+     * The object cannot be saved. Its changes have been discarded.
+     **/
+    PMPersistentStoreErrorCodeSave = 1,
+    
+    /**
+     * The stored data of the object cannot be read or decoded.
+     **/
+    PMPersistentStoreErrorCodeCorruptedData = 2
+} PMPersistentStoreErrorCode;
+
 /**
  * This is an abstract class that encapsulates the main functionalities for the persistent store.
  * Subclasses may override all methods and implement them following the specifications.
@@ -88,6 +136,14 @@ extern NSString * const PMPersistentStoreObjectKey;
  **/
 - (id<PMPersistentObject>)persistentObjectWithKey:(NSString*)key;
 
+/**
+ * This method retrieves from the store the objects with the given key identifiers. Keys not found in the store are ignored.
+ * @param keys An array of model object identifiers. Cannot be nil.
+ * @return An array with the found persistent objects, in no particular order.
+ * @discussion The default implementation calls `persistentObjectWithKey:` for each key. Subclasses may override this method to retrieve all objects at once.
+ **/
+- (NSArray*)persistentObjectsWithKeys:(NSArray*)keys;
+
 /**
  * This method queries all stored objects for the given type.
  * @param type The model object type. Cannot be nil.
@@ -95,6 +151,61 @@ extern NSString * const PMPersistentStoreObjectKey;
  **/
 - (NSArray*)persistentObjectsOfType:(NSString*)type;
 
+/**
+ * This method queries all stored objects for the given type, optionally without loading their data.
+ * @param type The model object type. Cannot be nil.
+ * @param includesData If NO, returned objects contain only the key, type and last update, and their `data` is nil.
+ * @return An array with all stored objects of the given type.
+ * @discussion Objects returned without data must not be modified. The default implementation ignores the flag and calls `persistentObjectsOfType:`.
+ **/
+- (NSArray*)persistentObjectsOfType:(NSString*)type includesData:(BOOL)includesData;
+
+/**
+ * This method queries a page of stored objects for the given type.
+ * @param type The model object type. Cannot be nil.
+ * @param offset The number of objects to skip.
+ * @param limit The maximum number of objects to return.
+ * @param order The order of the objects.
+ * @return An array with the stored objects of the given type in the given range, sorted with the given order.
+ * @discussion The default implementation queries all objects of the type with `persistentObjectsOfType:` and sorts them in memory. Subclasses may override this method to query only the requested page.
+ **/
+- (NSArray*)persistentObjectsOfType:(NSString*)type offset:(NSUInteger)offset limit:(NSUInteger)limit order:(PMOptionOrder)order;
+
+/**
+ * This method queries the stored objects for the given type whose key follows the given one, sorted by key.
+ * @param type The model object type. Cannot be nil.
+ * @param key The key to start after. If nil, objects are returned from the first key.
+ * @param limit The maximum number of objects to return.
+ * @return An array with at most `limit` stored objects, sorted by ascending key.
+ * @discussion Used to enumerate all objects of a type in batches: each batch starts after the last key of the previous one. Objects returned by this method are considered accessed, as with any other query. The default implementation queries all objects of the type with `persistentObjectsOfType:` and filters them in memory.
+ **/
+- (NSArray*)persistentObjectsOfType:(NSString*)type afterKey:(NSString*)key limit:(NSUInteger)limit;
+
+/**
+ * Counts the stored objects of the given type.
+ * @param type The model object type. Cannot be nil.
+ * @return The number of stored objects of the given type.
+ * @discussion Objects are neither loaded nor considered accessed. The default implementation counts the objects returned by `persistentObjectsOfType:includesData:` without data. Subclasses may override this method to count objects without creating them.
+ **/
+- (NSUInteger)countOfObjectsOfType:(NSString*)type;
+
+/**
+ * Queries the keys of the stored objects of the given type updated since the given date.
+ * @param type The model object type. Cannot be nil.
+ * @param date Objects whose last update is equal or later than this date are returned. If nil, the keys of all objects of the type are returned.
+ * @return An array with the keys, in no particular order.
+ * @discussion Objects are neither loaded nor considered accessed. The default implementation filters the objects returned by `persistentObjectsOfType:includesData:` without data. Subclasses may override this method to query keys without creating objects.
+ **/
+- (NSArray*)keysOfType:(NSString*)type updatedSince:(NSDate*)date;
+
+/**
+ * Returns the last update of the stored object with the given key.
+ * @param key The model object identifier. Cannot be nil.
+ * @return The last update of the object, or nil if there is no stored object with the given key.
+ * @discussion The object is neither loaded nor considered accessed. The default implementation returns the last update of the object returned by `persistentObjectWithKey:`. Subclasses may override this method to read the last update without loading the object data.
+ **/
+- (NSDate*)lastUpdateForKey:(NSString*)key;
+
 /**
  * Creates a new persistent object and returns it for a model object key and type.
  * @param key The model object identifier. Cannot be nil.
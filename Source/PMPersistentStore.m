@@ -27,6 +27,9 @@
 #import "PMPersistentObject.h"
 
 NSString * const PMPersistentStoreObjectKey = @"PMPersistentStoreObjectKey";
+NSString * const PMPersistentStoreDidFailNotification = @"PMPersistentStoreDidFailNotification";
+NSString * const PMPersistentStoreErrorKey = @"PMPersistentStoreErrorKey";
+NSString * const PMPersistentStoreErrorDomain = @"PMPersistentStoreErrorDomain";
 
 @implementation PMPersistentStore
 
@@ -54,12 +57,92 @@ NSString * const PMPersistentStoreObjectKey = @"PMPersistentStoreObjectKey";
     return nil;
 }
 
+- (NSArray*)persistentObjectsWithKeys:(NSArray*)keys
+{
+    NSMutableArray *array = [NSMutableArray arrayWithCapacity:keys.count];
+    
+    for (NSString *key in [NSSet setWithArray:keys])
+    {
+        id<PMPersistentObject> object = [self persistentObjectWithKey:key];
+        
+        if (object)
+            [array addObject:object];
+    }
+    
+    return array;
+}
+
 - (NSArray*)persistentObjectsOfType:(NSString*)type
 {
     // Subclasses must override.
     return nil;
 }
 
+- (NSArray*)persistentObjectsOfType:(NSString*)type includesData:(BOOL)includesData
+{
+    return [self persistentObjectsOfType:type];
+}
+
+- (NSArray*)persistentObjectsOfType:(NSString*)type offset:(NSUInteger)offset limit:(NSUInteger)limit order:(PMOptionOrder)order
+{
+    NSArray *sortDescriptors = nil;
+    
+    if (order == PMOptionOrderByUpdateDate)
+        sortDescriptors = @[[NSSortDescriptor sortDescriptorWithKey:@"lastUpdate" ascending:YES], [NSSortDescriptor sortDescriptorWithKey:@"key" ascending:YES]];
+    else
+        sortDescriptors = @[[NSSortDescriptor sortDescriptorWithKey:@"key" ascending:YES]];
+    
+    NSArray *objects = [[self persistentObjectsOfType:type] sortedArrayUsingDescriptors:sortDescriptors];
+    
+    if (offset >= objects.count)
+        return @[];
+    
+    return [objects subarrayWithRange:NSMakeRange(offset, MIN(limit, objects.count - offset))];
+}
+
+- (NSArray*)persistentObjectsOfType:(NSString*)type afterKey:(NSString*)key limit:(NSUInteger)limit
+{
+    NSArray *objects = [self persistentObjectsOfType:type];
+    
+    if (key)
+    {
+        NSPredicate *predicate = [NSPredicate predicateWithBlock:^BOOL(id<PMPersistentObject> object, NSDictionary *bindings) {
+            return [object.key compare:key options:NSLiteralSearch] == NSOrderedDescending;
+        }];
+        
+        objects = [objects filteredArrayUsingPredicate:predicate];
+    }
+    
+    objects = [objects sortedArrayUsingComparator:^NSComparisonResult(id<PMPersistentObject> object1, id<PMPersistentObject> object2) {
+        return [object1.key compare:object2.key options:NSLiteralSearch];
+    }];
+    
+    return [objects subarrayWithRange:NSMakeRange(0, MIN(limit, objects.count))];
+}
+
+- (NSUInteger)countOfObjectsOfType:(NSString*)type
+{
+    return [self persistentObjectsOfType:type includesData:NO].count;
+}
+
+- (NSArray*)keysOfType:(NSString*)type updatedSince:(NSDate*)date
+{
+    NSMutableArray *keys = [NSMutableArray array];
+    
+    for (id<PMPersistentObject> object in [self persistentObjectsOfType:type includesData:NO])
+    {
+        if (date == nil || (object.lastUpdate && [object.lastUpdate compare:date] != NSOrderedAscending))
+            [keys addObject:object.key];
+    }
+    
+    return keys;
+}
+
+- (NSDate*)lastUpdateForKey:(NSString*)key
+{
+    return [[self persistentObjectWithKey:key] lastUpdate];
+}
+
 - (id<PMPersistentObject>)createPersistentObjectWithKey:(NSString*)key ofType:(NSString*)type
 {
     // Subclasses must override.
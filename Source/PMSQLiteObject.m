@@ -69,8 +69,8 @@
 
 - (NSUInteger)hash
 {
-    NSString *string = [NSString stringWithFormat:@"%ld-%@",(long)_dbID, _key];
-    return string.hash;
+    // Must not change while the object is in a set: the identifier is assigned on insertion.
+    return _key.hash;
 }
 
 #pragma mark Properties
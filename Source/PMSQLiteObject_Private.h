@@ -29,6 +29,11 @@
  **/
 @interface PMSQLiteObject ()
 
+/**
+ * Last recorded access, as a time interval since 1970. Zero if never accessed.
+ **/
+@property (nonatomic, assign) NSTimeInterval lastAccessTime;
+
 /**
  * Use this method to modify the readonly 'hasChanges' property in a 'PMSQLiteObject'.
  * @param hasChanges Flag indicating if has changes.
@@ -26,22 +26,156 @@
 
 @class PMSQLiteObject;
 
+/**
+ * Access date tracking modes.
+ **/
+typedef enum __PMAccessTracking
+{
+    /**
+     * Access dates are not tracked.
+     **/
+    PMAccessTrackingNone,
+    
+    /**
+     * Accesses are recorded in memory at most once per object every `accessTrackingInterval` seconds and written in batch.
+     **/
+    PMAccessTrackingCoarse,
+    
+    /**
+     * Every access is recorded in memory and written in batch.
+     **/
+    PMAccessTrackingExact
+} PMAccessTracking;
+
 /**
  * SQLite implementation for the PMPersistentStore.
  *
  * This class uses the FMDB SQLite database management.
  * You can download the latest version in https://github.com/ccgus/fmdb
+ *
+ * The database schema is versioned. Stores created with a previous schema are upgraded in place when opened.
+ *
+ * Each object is stored in a single row holding its metadata and its data: reading an object by key probes the key index and the table, without joins, and updates write a single row. Counts and keys by type are answered from covering indexes without reading the rows holding the data. Dates are indexed by type only: deleting entries of all types older than a date scans the whole table. Stores created before version 4 keep the data in a separate table, which is moved into the objects table on first open. This takes time proportional to the size of the store.
+ *
+ * A save writes all changes in a single transaction. If it fails, the changes are kept and retried by the next save, except for an object failing by itself (ie. a constraint violation): its changes are discarded and it is reported in a 'PMPersistentStoreDidFailNotification' notification, so it can't block later saves.
  **/
 @interface PMSQLiteStore : PMPersistentStore
 
 
+/** ---------------------------------------------------------------- **
+ *  @name Creating instances and initializing
+ ** ---------------------------------------------------------------- **/
+
+/**
+ * Initializer enabling concurrent reads.
+ * @param url The url of the SQLite database file.
+ * @param maximumConcurrentReaders The maximum number of read only connections. Zero disables concurrent reads.
+ * @return The initialized instance.
+ * @discussion When concurrent reads are enabled, the database runs in WAL journal mode: writes are serialized in one connection while `persistentObjectWithKey:` and `persistentObjectsOfType:` are served by a pool of read only connections, in parallel with writes. Readers only see saved changes. The default initializer `initWithURL:` uses a single connection.
+ **/
+- (id)initWithURL:(NSURL*)url maximumConcurrentReaders:(NSUInteger)maximumConcurrentReaders;
+
+/**
+ * The maximum number of read only connections. Zero if concurrent reads are disabled.
+ **/
+@property (nonatomic, assign, readonly) NSUInteger maximumConcurrentReaders;
+
+
+
 /** ---------------------------------------------------------------- **
  *  @name Managing the Store
  ** ---------------------------------------------------------------- **/
 
 /**
  * Call this method to clean the current cached persisted objects.
+ * @discussion Objects with unsaved changes stay cached until the next `save`.
  **/
 - (void)cleanCache;
 
+/**
+ * Maximum number of cached objects. Zero means no limit. Default value is 1024.
+ * @discussion Least recently used objects are evicted first. Objects with unsaved changes are never evicted and are not counted.
+ **/
+@property (nonatomic, assign) NSUInteger cacheCountLimit;
+
+/**
+ * Maximum total size in bytes of the data of the cached objects. Zero means no limit. Default value is 8 MB.
+ * @discussion Least recently used objects are evicted first. Objects with unsaved changes are never evicted and are not counted.
+ **/
+@property (nonatomic, assign) NSUInteger cacheCostLimit;
+
+/**
+ * Number of persistent object lookups served from the cache.
+ **/
+@property (nonatomic, assign, readonly) NSUInteger cacheHitCount;
+
+/**
+ * Number of persistent object lookups not found in the cache.
+ **/
+@property (nonatomic, assign, readonly) NSUInteger cacheMissCount;
+
+/**
+ * Number of objects evicted from the cache to honor its limits.
+ **/
+@property (nonatomic, assign, readonly) NSUInteger cacheEvictionCount;
+
+
+/** ---------------------------------------------------------------- **
+ *  @name Compressing Data
+ ** ---------------------------------------------------------------- **/
+
+/**
+ * If YES, the data of persistent objects is compressed with zlib before being written. Default value is NO.
+ * @discussion Compressed and uncompressed data coexist in the same database: data is always decompressed when read, whatever the current settings. Data is compressed only if it gets smaller. Objects whose data cannot be decompressed are returned without data and reported in a 'PMPersistentStoreDidFailNotification' notification.
+ **/
+@property (nonatomic, assign) BOOL compressesData;
+
+/**
+ * Minimum length in bytes of the data to compress. Default value is 256 bytes.
+ * @discussion Small data barely compresses and is stored uncompressed.
+ **/
+@property (nonatomic, assign) NSUInteger compressionThreshold;
+
+/**
+ * Overrides `compressesData` for the persistent objects of the given type.
+ * @param flag YES to compress the data of the given type, NO otherwise.
+ * @param type The type of the persistent objects.
+ **/
+- (void)setCompressesData:(BOOL)flag forType:(NSString*)type;
+
+/**
+ * Sets a preset dictionary used to compress the data of the given type.
+ * @param dictionary The dictionary, typically a sample of the most repeated strings of the type (ie. URLs, user names, enum values). Nil to stop using a dictionary.
+ * @param type The type of the persistent objects.
+ * @discussion A dictionary improves the compression of small data a lot. Data compressed with a dictionary can only be read when that dictionary has been set to the store: when replacing a dictionary, keep setting the old one to a type until all its data is rewritten.
+ **/
+- (void)setCompressionDictionary:(NSData*)dictionary forType:(NSString*)type;
+
+
+/** ---------------------------------------------------------------- **
+ *  @name Tracking Accesses
+ ** ---------------------------------------------------------------- **/
+
+/**
+ * The access date tracking mode. Default value is `PMAccessTrackingExact`.
+ * @discussion Accesses are never written on read. They are kept in memory and written in a single transaction by the next `save`, by `flushAccessDates` or periodically every `accessFlushInterval` seconds. Deleting with the `PMOptionDeleteByAccessDate` policy writes the pending accesses first.
+ **/
+@property (nonatomic, assign) PMAccessTracking accessTracking;
+
+/**
+ * Minimum time between two recorded accesses of the same object when using `PMAccessTrackingCoarse`. Default value is 60 seconds.
+ **/
+@property (nonatomic, assign) NSTimeInterval accessTrackingInterval;
+
+/**
+ * Maximum time a recorded access waits in memory before being written. Default value is 30 seconds.
+ **/
+@property (nonatomic, assign) NSTimeInterval accessFlushInterval;
+
+/**
+ * Writes all pending accesses into the database.
+ * @return YES if succeed, otherwise NO.
+ **/
+- (BOOL)flushAccessDates;
+
 @end
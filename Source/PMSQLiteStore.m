@@ -30,33 +30,110 @@
 #import "FMDatabaseQueue.h"
 #import "FMResultSet.h"
 
+#import <zlib.h>
+
 #import "PMSQLiteObject_Private.h"
+#import "PMObjectCache.h"
+#import "PMMetrics.h"
 
 static NSString * const PMSQLiteStoreUpdateException = @"PMSQLiteStoreUpdateException";
 
+/**
+ * Maximum number of keys bound in a single `IN (...)` query. SQLite defaults to 999 parameters per statement.
+ **/
+static NSUInteger const PMSQLiteStoreMaximumQueryParameters = 500;
+
+/**
+ * Current version of the database schema, stored in the `user_version` pragma. Version 1 stores have no version (0).
+ **/
+static NSInteger const PMSQLiteStoreSchemaVersion = 5;
+
+/**
+ * Compressed blobs start with this magic, followed by the codec byte and the uncompressed length (4 bytes, little endian).
+ * Blobs without the magic are stored uncompressed, so compressed and uncompressed rows coexist.
+ **/
+static const uint8_t PMSQLiteStoreCompressionMagic[3] = {'P', 'M', 'Z'};
+
+/**
+ * Length of the header of compressed blobs.
+ **/
+static NSUInteger const PMSQLiteStoreCompressionHeaderLength = 8;
+
+/**
+ * Maximum ratio between the uncompressed and the compressed length of a zlib stream.
+ * @discussion Deflate cannot encode a 258 bytes match in less than 2 bits, so longer uncompressed lengths are corrupted headers.
+ **/
+static NSUInteger const PMSQLiteStoreMaximumCompressionRatio = 1032;
+
+/**
+ * Codecs of blobs starting with the compression magic.
+ **/
+typedef enum __PMSQLiteStoreCompressionCodec
+{
+    /**
+     * Uncompressed data starting with the compression magic, stored behind a header.
+     **/
+    PMSQLiteStoreCompressionCodecNone = 0,
+    
+    /**
+     * Zlib stream, optionally using the preset dictionary of the type.
+     **/
+    PMSQLiteStoreCompressionCodecZlib = 1
+} PMSQLiteStoreCompressionCodec;
+
 #define UpdateException [NSException exceptionWithName:PMSQLiteStoreUpdateException reason:nil userInfo:nil]
 
 @implementation PMSQLiteStore
 {
     FMDatabaseQueue *_dbQueue;
-    NSMutableDictionary *_dictionary;
+    FMDatabasePool *_readerPool;
+    dispatch_semaphore_t _readerSemaphore;
+    PMObjectCache *_cache;
     
+    NSLock *_changesLock;
     NSMutableSet *_insertedObjects;
     NSMutableSet *_deletedObjects;
     NSMutableSet *_updatedObjects;
+    
+    NSMutableDictionary *_pendingAccesses;
+    BOOL _isAccessFlushScheduled;
+    
+    NSMutableDictionary *_compressedTypes;
+    NSMutableDictionary *_compressionDictionaries;
+    NSMutableDictionary *_compressionDictionariesByID;
 }
 
 - (id)initWithURL:(NSURL *)url
+{
+    return [self initWithURL:url maximumConcurrentReaders:0];
+}
+
+- (id)initWithURL:(NSURL*)url maximumConcurrentReaders:(NSUInteger)maximumConcurrentReaders
 {
     self = [super initWithURL:url];
     if (self)
     {
-        _dictionary = [NSMutableDictionary dictionary];
+        _maximumConcurrentReaders = maximumConcurrentReaders;
         
+        _cache = [[PMObjectCache alloc] initWithCountLimit:1024 costLimit:8 * 1024 * 1024];
+        
+        _changesLock = [[NSLock alloc] init];
         _insertedObjects = [NSMutableSet set];
         _deletedObjects = [NSMutableSet set];
         _updatedObjects = [NSMutableSet set];
         
+        _pendingAccesses = [NSMutableDictionary dictionary];
+        _isAccessFlushScheduled = NO;
+        _accessTracking = PMAccessTrackingExact;
+        _accessTrackingInterval = 60;
+        _accessFlushInterval = 30;
+        
+        _compressesData = NO;
+        _compressionThreshold = 256;
+        _compressedTypes = [NSMutableDictionary dictionary];
+        _compressionDictionaries = [NSMutableDictionary dictionary];
+        _compressionDictionariesByID = [NSMutableDictionary dictionary];
+        
         if (url)
         {
             if ([[NSFileManager defaultManager] fileExistsAtPath:[url path]])
@@ -68,6 +145,31 @@ static NSString * const PMSQLiteStoreUpdateException = @"PMSQLiteStoreUpdateExce
                 _dbQueue = [FMDatabaseQueue databaseQueueWithPath:[url path]];
                 [self pmd_createTables];
             }
+            
+            [self pmd_migrateSchema];
+            
+            // Saves run the same few statements once per object: keep them prepared.
+            [_dbQueue inDatabase:^(FMDatabase *db) {
+                db.shouldCacheStatements = YES;
+            }];
+            
+            if (_maximumConcurrentReaders > 0)
+            {
+                // In WAL mode readers don't block the writer and the writer doesn't block readers.
+                [_dbQueue inDatabase:^(FMDatabase *db) {
+                    FMResultSet *resultSet = [db executeQuery:@"PRAGMA journal_mode = WAL"];
+                    [resultSet next];
+                    [resultSet close];
+                    
+                    [db executeUpdate:@"PRAGMA synchronous = NORMAL"];
+                }];
+                
+                _readerPool = [FMDatabasePool databasePoolWithPath:[url path] flags:SQLITE_OPEN_READONLY];
+                _readerPool.maximumNumberOfDatabasesToCreate = _maximumConcurrentReaders;
+                
+                // The pool hands out no connection once all are checked out: readers wait for a free one.
+                _readerSemaphore = dispatch_semaphore_create(_maximumConcurrentReaders);
+            }
         }
     }
     return self;
@@ -75,6 +177,10 @@ static NSString * const PMSQLiteStoreUpdateException = @"PMSQLiteStoreUpdateExce
 
 - (void)dealloc
 {
+    [self flushAccessDates];
+    
+    [_readerPool releaseAllDatabases];
+    
     [_dbQueue close];
 }
 
@@ -90,37 +196,81 @@ static NSString * const PMSQLiteStoreUpdateException = @"PMSQLiteStoreUpdateExce
         return nil;
     }
     
-    __block PMSQLiteObject *persistentObject = [_dictionary valueForKey:key];
+    __block PMSQLiteObject *persistentObject = [_cache objectForKey:key];
     
     if (!persistentObject)
     {
-        [_dbQueue inDatabase:^(FMDatabase *db) {
-            FMResultSet *resultSet = [db executeQueryWithFormat:@"SELECT Objects.id, Objects.type, Objects.updateDate, Data.data FROM Objects JOIN Data ON Objects.id = Data.id WHERE Objects.key = %@", key];
+        [self pmd_inReaderDatabase:^(FMDatabase *db) {
+            FMResultSet *resultSet = [db executeQuery:@"SELECT id, key, type, updateDate, accessDate, data FROM Objects WHERE key = ?", key];
             
             if ([resultSet next])
-            {
-                persistentObject = [[PMSQLiteObject alloc] initWithDataBaseIdentifier:[resultSet intForColumnIndex:0]];
-                persistentObject.key = key;
-                persistentObject.type = [resultSet stringForColumnIndex:1];
-                persistentObject.lastUpdate = [NSDate dateWithTimeIntervalSince1970:[resultSet doubleForColumnIndex:2]];
-                persistentObject.data = [resultSet dataForColumnIndex:3];
-                
-                persistentObject.persistentStore = self;
-                
-                [resultSet close];
-            }
+                persistentObject = [self pmd_persistentObjectFromResultSet:resultSet];
+            
+            [resultSet close];
         }];
         
+        // A save could have queued a changed object for the key meanwhile: keep it.
         if (persistentObject)
-            [_dictionary setValue:persistentObject forKey:key];
+            persistentObject = [_cache setObjectIfAbsent:persistentObject forKey:key cost:persistentObject.data.length];
     }
     
     if (persistentObject)
-        [self pmd_didAccessObjectWithID:persistentObject.dbID];
+        [self pmd_didAccessPersistentObject:persistentObject];
     
     return persistentObject;
 }
 
+- (NSArray*)persistentObjectsWithKeys:(NSArray*)keys
+{
+    if (keys == nil)
+    {
+        NSString *reason = @"Cannot query for persistent objects with a nil array of keys.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    NSMutableArray *array = [NSMutableArray arrayWithCapacity:keys.count];
+    NSMutableArray *missingKeys = [NSMutableArray array];
+    
+    for (NSString *key in [NSSet setWithArray:keys])
+    {
+        PMSQLiteObject *persistentObject = [_cache objectForKey:key];
+        
+        if (persistentObject)
+            [array addObject:persistentObject];
+        else
+            [missingKeys addObject:key];
+    }
+    
+    NSMutableArray *fetchedObjects = [NSMutableArray arrayWithCapacity:missingKeys.count];
+    
+    // SQLite limits the number of parameters of a statement: query by chunks.
+    for (NSUInteger location = 0; location < missingKeys.count; location += PMSQLiteStoreMaximumQueryParameters)
+    {
+        NSRange range = NSMakeRange(location, MIN(PMSQLiteStoreMaximumQueryParameters, missingKeys.count - location));
+        NSArray *chunk = [missingKeys subarrayWithRange:range];
+        
+        NSString *query = [NSString stringWithFormat:@"SELECT id, key, type, updateDate, accessDate, data FROM Objects WHERE key IN (%@)", [self pmd_parametersStringWithCount:chunk.count]];
+        
+        [self pmd_inReaderDatabase:^(FMDatabase *db) {
+            FMResultSet *resultSet = [db executeQuery:query withArgumentsInArray:chunk];
+            
+            while ([resultSet next])
+                [fetchedObjects addObject:[self pmd_persistentObjectFromResultSet:resultSet]];
+            
+            [resultSet close];
+        }];
+    }
+    
+    [array addObjectsFromArray:[self pmd_cachedPersistentObjects:fetchedObjects]];
+    
+    for (PMSQLiteObject *persistentObject in array)
+        [self pmd_didAccessPersistentObject:persistentObject];
+    
+    return array;
+}
+
 - (NSArray*)persistentObjectsOfType:(NSString*)type
 {
     if (type == nil)
@@ -133,36 +283,206 @@ static NSString * const PMSQLiteStoreUpdateException = @"PMSQLiteStoreUpdateExce
     
     __block  NSMutableArray *array = nil;
     
-    NSMutableArray *dbIDs = [NSMutableArray array];
+    [self pmd_inReaderDatabase:^(FMDatabase *db) {
+        FMResultSet *resultSet = [db executeQuery:@"SELECT id, key, type, updateDate, accessDate, data FROM Objects WHERE type = ?", type];
+        
+        array = [NSMutableArray array];
+        
+        while ([resultSet next])
+            [array addObject:[self pmd_persistentObjectFromResultSet:resultSet]];
+        
+        [resultSet close];
+    }];
+    
+    array = [self pmd_cachedPersistentObjects:array];
+
+    for (PMSQLiteObject *persistentObject in array)
+        [self pmd_didAccessPersistentObject:persistentObject];
+    
+    return array;
+}
+
+- (NSArray*)persistentObjectsOfType:(NSString*)type includesData:(BOOL)includesData
+{
+    if (includesData)
+        return [self persistentObjectsOfType:type];
+    
+    if (type == nil)
+    {
+        NSString *reason = @"Cannot query for persistent objects with a nil type.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    __block NSMutableArray *array = nil;
     
-    [_dbQueue inDatabase:^(FMDatabase *db) {
-        FMResultSet *resultSet = [db executeQueryWithFormat:@"SELECT Objects.id, Objects.key, Objects.type, Objects.updateDate, Data.data FROM Objects JOIN Data ON Objects.id = Data.id WHERE Objects.type = %@", type];
+    // Data is not read: objects are neither cached nor accessed.
+    [self pmd_inReaderDatabase:^(FMDatabase *db) {
+        FMResultSet *resultSet = [db executeQuery:@"SELECT id, key, type, updateDate, accessDate, NULL FROM Objects WHERE type = ?", type];
         
         array = [NSMutableArray array];
         
         while ([resultSet next])
-        {
-            PMSQLiteObject *persistentObject = [[PMSQLiteObject alloc] initWithDataBaseIdentifier:[resultSet intForColumnIndex:0]];
-            persistentObject.key = [resultSet stringForColumnIndex:1];
-            persistentObject.type = [resultSet stringForColumnIndex:2];
-            persistentObject.lastUpdate = [NSDate dateWithTimeIntervalSince1970:[resultSet doubleForColumnIndex:3]];
-            persistentObject.data = [resultSet dataForColumnIndex:4];
-            
-            persistentObject.persistentStore = self;
-            
-            [array addObject:persistentObject];
-            [dbIDs addObject:@(persistentObject.dbID)];
-        }
+            [array addObject:[self pmd_persistentObjectFromResultSet:resultSet]];
+        
+        [resultSet close];
+    }];
+    
+    return array;
+}
+
+- (NSArray*)persistentObjectsOfType:(NSString*)type offset:(NSUInteger)offset limit:(NSUInteger)limit order:(PMOptionOrder)order
+{
+    if (type == nil)
+    {
+        NSString *reason = @"Cannot query for persistent objects with a nil type.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    NSString *orderClause = (order == PMOptionOrderByUpdateDate) ? @"updateDate, key" : @"key";
+    NSString *query = [NSString stringWithFormat:@"SELECT id, key, type, updateDate, accessDate, data FROM Objects WHERE type = ? ORDER BY %@ LIMIT ? OFFSET ?", orderClause];
+    
+    __block NSMutableArray *array = nil;
+    
+    [self pmd_inReaderDatabase:^(FMDatabase *db) {
+        FMResultSet *resultSet = [db executeQuery:query, type, @(limit), @(offset)];
+        
+        array = [NSMutableArray array];
+        
+        while ([resultSet next])
+            [array addObject:[self pmd_persistentObjectFromResultSet:resultSet]];
         
         [resultSet close];
     }];
+    
+    array = [self pmd_cachedPersistentObjects:array];
+    
+    for (PMSQLiteObject *persistentObject in array)
+        [self pmd_didAccessPersistentObject:persistentObject];
+    
+    return array;
+}
 
-    for (NSNumber *dbID in dbIDs)
-        [self pmd_didAccessObjectWithID:[dbID integerValue]];
+- (NSArray*)persistentObjectsOfType:(NSString*)type afterKey:(NSString*)key limit:(NSUInteger)limit
+{
+    if (type == nil)
+    {
+        NSString *reason = @"Cannot query for persistent objects with a nil type.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    __block NSMutableArray *array = nil;
+    
+    // Keyset pagination: each batch seeks the (type, key) index instead of skipping the previous rows.
+    [self pmd_inReaderDatabase:^(FMDatabase *db) {
+        FMResultSet *resultSet = nil;
+        
+        if (key)
+            resultSet = [db executeQuery:@"SELECT id, key, type, updateDate, accessDate, data FROM Objects WHERE type = ? AND key > ? ORDER BY key LIMIT ?", type, key, @(limit)];
+        else
+            resultSet = [db executeQuery:@"SELECT id, key, type, updateDate, accessDate, data FROM Objects WHERE type = ? ORDER BY key LIMIT ?", type, @(limit)];
+        
+        array = [NSMutableArray array];
+        
+        while ([resultSet next])
+            [array addObject:[self pmd_persistentObjectFromResultSet:resultSet]];
+        
+        [resultSet close];
+    }];
+    
+    array = [self pmd_cachedPersistentObjects:array];
+    
+    for (PMSQLiteObject *persistentObject in array)
+        [self pmd_didAccessPersistentObject:persistentObject];
     
     return array;
 }
 
+- (NSUInteger)countOfObjectsOfType:(NSString*)type
+{
+    if (type == nil)
+    {
+        NSString *reason = @"Cannot count persistent objects with a nil type.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return 0;
+    }
+    
+    __block NSUInteger count = 0;
+    
+    // Answered from the (type, key) index, without reading any row.
+    [self pmd_inReaderDatabase:^(FMDatabase *db) {
+        FMResultSet *resultSet = [db executeQuery:@"SELECT COUNT(*) FROM Objects WHERE type = ?", type];
+        
+        if ([resultSet next])
+            count = (NSUInteger)[resultSet longLongIntForColumnIndex:0];
+        
+        [resultSet close];
+    }];
+    
+    return count;
+}
+
+- (NSArray*)keysOfType:(NSString*)type updatedSince:(NSDate*)date
+{
+    if (type == nil)
+    {
+        NSString *reason = @"Cannot query for keys with a nil type.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    __block NSMutableArray *keys = nil;
+    
+    // Answered from the (type, updateDate, key) index: rows holding the data are not read.
+    [self pmd_inReaderDatabase:^(FMDatabase *db) {
+        FMResultSet *resultSet = nil;
+        
+        if (date)
+            resultSet = [db executeQuery:@"SELECT key FROM Objects WHERE type = ? AND updateDate >= ?", type, @([date timeIntervalSince1970])];
+        else
+            resultSet = [db executeQuery:@"SELECT key FROM Objects WHERE type = ?", type];
+        
+        keys = [NSMutableArray array];
+        
+        while ([resultSet next])
+            [keys addObject:[resultSet stringForColumnIndex:0]];
+        
+        [resultSet close];
+    }];
+    
+    return keys;
+}
+
+- (NSDate*)lastUpdateForKey:(NSString*)key
+{
+    if (key == nil)
+    {
+        NSString *reason = @"Cannot query for the last update of a nil key.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    __block NSDate *lastUpdate = nil;
+    
+    [self pmd_inReaderDatabase:^(FMDatabase *db) {
+        FMResultSet *resultSet = [db executeQuery:@"SELECT updateDate FROM Objects WHERE key = ?", key];
+        
+        if ([resultSet next] && ![resultSet columnIndexIsNull:0])
+            lastUpdate = [NSDate dateWithTimeIntervalSince1970:[resultSet doubleForColumnIndex:0]];
+        
+        [resultSet close];
+    }];
+    
+    return lastUpdate;
+}
 
 - (PMSQLiteObject*)createPersistentObjectWithKey:(NSString*)key ofType:(NSString*)type
 {
@@ -194,8 +514,28 @@ static NSString * const PMSQLiteStoreUpdateException = @"PMSQLiteStoreUpdateExce
     PMSQLiteObject *object = [[PMSQLiteObject alloc] initWithKey:key andType:type];
     object.persistentStore = self;
     
-    [_dictionary setValue:object forKey:key];
-    [_insertedObjects addObject:object];
+    [_changesLock lock];
+    
+    // Another thread could have created an object for the same key meanwhile.
+    existingObject = [_cache objectForKey:key];
+    
+    if (!existingObject)
+    {
+        // Queued objects are pinned in the cache until saved.
+        [_cache setObject:object forKey:key cost:0];
+        [_cache pinObjectForKey:key];
+        [_insertedObjects addObject:object];
+    }
+    
+    [_changesLock unlock];
+    
+    if (existingObject)
+    {
+        NSString *reason = @"Cannot create a persitent object because it exists already an object with the given key.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:@{PMPersistentStoreObjectKey: existingObject}];
+        [exception raise];
+        return nil;
+    }
     
     return object;
 }
@@ -212,7 +552,9 @@ static NSString * const PMSQLiteStoreUpdateException = @"PMSQLiteStoreUpdateExce
     
     PMSQLiteObject *object = [self persistentObjectWithKey:key];
     
-    [_dictionary removeObjectForKey:key];
+    [_changesLock lock];
+    
+    [_cache removeObjectForKey:key];
     
     // If the object is queued to be inserted, remove from the queue.
     if ([_insertedObjects containsObject:object])
@@ -233,6 +575,8 @@ static NSString * const PMSQLiteStoreUpdateException = @"PMSQLiteStoreUpdateExce
         
         // otherwise, there is nothing to do, the object is not stored in persistence.
     }
+    
+    [_changesLock unlock];
 }
 
 - (BOOL)deleteEntriesOfType:(NSString*)type olderThan:(NSDate*)date policy:(PMOptionDelete)option // <-- THIS METHOD SHOULD BE IN CONTEXT, NOT IN DB
@@ -253,41 +597,42 @@ static NSString * const PMSQLiteStoreUpdateException = @"PMSQLiteStoreUpdateExce
             break;
     }
     
-    NSString *query0 = nil;
-    NSString *query1 = nil;
-    NSString *query2 = nil;
-
-    if (type && ! date)
-    {
-        query0 = [NSString stringWithFormat:@"SELECT Objects.key FROM Objects WHERE type = \"%@\"",type];
-        query1 = [NSString stringWithFormat:@"DELETE FROM Data WHERE id IN (SELECT Objects.id FROM Objects WHERE type = \"%@\")",type];
-        query2 = [NSString stringWithFormat:@"DELETE FROM Objects WHERE type = \"%@\"", type];
-    }
-    else if (!type && date)
+    NSMutableArray *conditions = [NSMutableArray array];
+    NSMutableArray *arguments = [NSMutableArray array];
+    
+    if (type)
     {
-        query0 = [NSString stringWithFormat:@"SELECT Objects.key FROM Objects WHERE %@ < %f",optionDate, [date timeIntervalSince1970]];
-        query1 = [NSString stringWithFormat:@"DELETE FROM Data WHERE id IN (SELECT Objects.id FROM Objects WHERE %@ < %f)",optionDate, [date timeIntervalSince1970]];
-        query2 = [NSString stringWithFormat:@"DELETE FROM Objects WHERE %@ < %f",optionDate, [date timeIntervalSince1970]];
+        [conditions addObject:@"type = ?"];
+        [arguments addObject:type];
     }
-    else if (type && date)
+    
+    if (date)
     {
-        query0 = [NSString stringWithFormat:@"SELECT Objects.key FROM Objects WHERE type = \"%@\" AND %@ < %f)", type, optionDate, [date timeIntervalSince1970]];
-        query1 = [NSString stringWithFormat:@"DELETE FROM Data WHERE id IN (SELECT Objects.id FROM Objects WHERE type = \"%@\" AND %@ < %f)", type, optionDate, [date timeIntervalSince1970]];
-        query2 = [NSString stringWithFormat:@"DELETE FROM Objects WHERE type = \"%@\" AND %@ < %f",type, optionDate, [date timeIntervalSince1970]];
+        [conditions addObject:[NSString stringWithFormat:@"%@ < ?", optionDate]];
+        [arguments addObject:@([date timeIntervalSince1970])];
     }
-    else //if (!type && !date)
+    
+    NSString *query0 = @"SELECT key FROM Objects";
+    NSString *query1 = @"DELETE FROM Objects";
+    
+    if (conditions.count > 0)
     {
-        query0 = @"SELECT Objects.key FROM Objects";
-        query1 = @"DELETE FROM Data";
-        query2 = @"DELETE FROM Objects";
+        NSString *whereClause = [@" WHERE " stringByAppendingString:[conditions componentsJoinedByString:@" AND "]];
+        
+        query0 = [query0 stringByAppendingString:whereClause];
+        query1 = [query1 stringByAppendingString:whereClause];
     }
     
+    // Pending accesses must be written before comparing access dates.
+    if (date && option == PMOptionDeleteByAccessDate)
+        [self flushAccessDates];
+    
     __block BOOL succeed = YES;
     
     [_dbQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
         @try
         {
-            FMResultSet *resultSet = [db executeQuery:query0];
+            FMResultSet *resultSet = [db executeQuery:query0 withArgumentsInArray:arguments];
             
             NSMutableArray *keys = [NSMutableArray array];
             while ([resultSet next])
@@ -298,14 +643,11 @@ static NSString * const PMSQLiteStoreUpdateException = @"PMSQLiteStoreUpdateExce
             
             [resultSet close];
             
-            if(![db executeUpdate:query1])
-                @throw UpdateException;
-            
-            if (![db executeUpdate:query2])
+            if (![db executeUpdate:query1 withArgumentsInArray:arguments])
                 @throw UpdateException;
             
             // Once here, no exceptions happened!
-            [_dictionary removeObjectsForKeys:keys];
+            [_cache removeObjectsForKeys:keys];
         }
         @catch (NSException *exception)
         {
@@ -323,41 +665,153 @@ static NSString * const PMSQLiteStoreUpdateException = @"PMSQLiteStoreUpdateExce
 
 - (BOOL)save
 {
-    BOOL success = YES;
+    __block BOOL success = YES;
+    
+    NSTimeInterval waitStart = PMMetricsStart();
     
     @synchronized(self)
     {
-        NSMutableSet *insertedObjects = [_insertedObjects copy];
+        PMMetricsRecordDuration(PMMetricSQLiteSaveWait, waitStart);
+        
+        [_changesLock lock];
+        
+        NSSet *insertedObjects = [_insertedObjects copy];
         [_insertedObjects removeAllObjects];
         
-        NSMutableSet *deletedObjects = [_deletedObjects copy];
+        NSSet *deletedObjects = [_deletedObjects copy];
         [_deletedObjects removeAllObjects];
         
-        NSMutableSet *updatedObjects = [_updatedObjects copy];
+        NSSet *updatedObjects = [_updatedObjects copy];
         [_updatedObjects removeAllObjects];
         
+        [_changesLock unlock];
+        
+        NSDictionary *accesses = [self pmd_dequeuePendingAccesses];
+        
+        if (insertedObjects.count == 0 && deletedObjects.count == 0 && updatedObjects.count == 0 && accesses.count == 0)
+            return YES;
+        
+        NSTimeInterval saveStart = PMMetricsStart();
+        
+        __block PMSQLiteObject *failedObject = nil;
+        __block int errorCode = SQLITE_OK;
+        __block NSString *errorMessage = nil;
+        
+        // The whole change set is written in a single transaction: one journal sync per save instead of one per object.
+        [_dbQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
+            @try
+            {
+                NSNumber *creationDate = @([[NSDate date] timeIntervalSince1970]);
+                
+                // -- Inserted Objects -- //
+                for (PMSQLiteObject *object in insertedObjects)
+                {
+                    failedObject = object;
+                    if (![self pmd_insertPersistentObject:object creationDate:creationDate inDatabase:db])
+                        @throw UpdateException;
+                }
+                
+                // -- Deleted Objects -- //
+                for (PMSQLiteObject *object in deletedObjects)
+                {
+                    failedObject = object;
+                    if (![self pmd_deletePersistentObject:object inDatabase:db])
+                        @throw UpdateException;
+                }
+                
+                // -- Updated Objects -- //
+                for (PMSQLiteObject *object in updatedObjects)
+                {
+                    failedObject = object;
+                    if (![self pmd_updatePersistentObject:object inDatabase:db])
+                        @throw UpdateException;
+                }
+                
+                // -- Accessed Objects -- //
+                failedObject = nil;
+                if (![self pmd_writeAccesses:accesses inDatabase:db])
+                    @throw UpdateException;
+            }
+            @catch (NSException *exception)
+            {
+                success = NO;
+                errorCode = [db lastErrorCode];
+                errorMessage = [db lastErrorMessage];
+                
+                if ([exception.name isEqualToString:PMSQLiteStoreUpdateException])
+                    *rollback = YES;
+                else
+                    @throw exception;
+            }
+        }];
+        
+        PMMetricsRecordDuration(PMMetricSQLiteSave, saveStart);
+        
+        [_changesLock lock];
         
-        // -- Inserted Objects -- //
-        for (PMSQLiteObject *object in insertedObjects)
+        if (success)
         {
-            BOOL flag = [self pmd_insertPersistentObject:object];
-            success = success || flag;
+            for (PMSQLiteObject *object in insertedObjects)
+            {
+                [object pmd_setHasChanges:NO];
+                [_cache unpinObjectForKey:object.key cost:object.data.length];
+            }
+            
+            for (PMSQLiteObject *object in updatedObjects)
+            {
+                [object pmd_setHasChanges:NO];
+                
+                // Unless it has been changed again meanwhile.
+                if (![_updatedObjects containsObject:object])
+                    [_cache unpinObjectForKey:object.key cost:object.data.length];
+            }
         }
-        
-        // -- Deleted Objects -- //
-        for (PMSQLiteObject *object in deletedObjects)
+        else
         {
-            BOOL flag = [self pmd_deletePersistentObject:object];
-            success = success || flag;
+            // The transaction has been rolled back: nothing has been written.
+            // Restore the identifiers of the inserted objects and queue the change set again so a later save can retry it.
+            for (PMSQLiteObject *object in insertedObjects)
+                object.dbID = NSNotFound;
+            
+            // An object failing by itself would fail every retry: it is dropped and reported instead.
+            int primaryErrorCode = errorCode & 0xFF;
+            BOOL dropsFailedObject = failedObject && (primaryErrorCode == SQLITE_CONSTRAINT || primaryErrorCode == SQLITE_TOOBIG || primaryErrorCode == SQLITE_MISMATCH);
+            
+            if (dropsFailedObject)
+            {
+                NSMutableSet *set = [insertedObjects mutableCopy];
+                [set removeObject:failedObject];
+                insertedObjects = set;
+                
+                set = [deletedObjects mutableCopy];
+                [set removeObject:failedObject];
+                deletedObjects = set;
+                
+                set = [updatedObjects mutableCopy];
+                [set removeObject:failedObject];
+                updatedObjects = set;
+                
+                // The cached object holds the discarded changes: next reads load the stored one.
+                [failedObject pmd_setHasChanges:NO];
+                [_cache removeObjectForKey:failedObject.key];
+            }
+            
+            [_insertedObjects unionSet:insertedObjects];
+            [_deletedObjects unionSet:deletedObjects];
+            [_updatedObjects unionSet:updatedObjects];
+            
+            [self pmd_requeuePendingAccesses:accesses];
+            
+            if (!dropsFailedObject)
+                failedObject = nil;
         }
         
-        // -- Updated Objects -- //
-        for (PMSQLiteObject *object in updatedObjects)
+        [_changesLock unlock];
+        
+        if (!success)
         {
-            BOOL flag = [self pmd_updatePersistentObject:object];
-            if (flag)
-                [object pmd_setHasChanges:NO];
-            success = success || flag;
+            NSString *reason = [NSString stringWithFormat:@"SQLite error %d: %@", errorCode, errorMessage];
+            [self pmd_postFailureWithCode:PMPersistentStoreErrorCodeSave reason:reason persistentObject:failedObject];
         }
     }
     
@@ -368,28 +822,83 @@ static NSString * const PMSQLiteStoreUpdateException = @"PMSQLiteStoreUpdateExce
 
 - (void)cleanCache
 {
-    [_dictionary removeAllObjects];
+    [_cache removeAllObjects];
 }
 
-#pragma mark Private Methods
-
-- (void)pmd_didChangePersistentObject:(PMSQLiteObject*)object
+- (NSUInteger)cacheCountLimit
 {
-    if (object.dbID != NSNotFound)
-        [_updatedObjects addObject:object];
+    return _cache.countLimit;
 }
 
-- (BOOL)pmd_createTables
+- (void)setCacheCountLimit:(NSUInteger)cacheCountLimit
+{
+    _cache.countLimit = cacheCountLimit;
+}
+
+- (NSUInteger)cacheCostLimit
+{
+    return _cache.costLimit;
+}
+
+- (void)setCacheCostLimit:(NSUInteger)cacheCostLimit
+{
+    _cache.costLimit = cacheCostLimit;
+}
+
+- (NSUInteger)cacheHitCount
+{
+    return _cache.hitCount;
+}
+
+- (NSUInteger)cacheMissCount
+{
+    return _cache.missCount;
+}
+
+- (NSUInteger)cacheEvictionCount
 {
+    return _cache.evictionCount;
+}
+
+- (void)setCompressesData:(BOOL)flag forType:(NSString*)type
+{
+    @synchronized(_compressedTypes)
+    {
+        _compressedTypes[type] = @(flag);
+    }
+}
+
+- (void)setCompressionDictionary:(NSData*)dictionary forType:(NSString*)type
+{
+    @synchronized(_compressedTypes)
+    {
+        if (dictionary.length == 0)
+        {
+            [_compressionDictionaries removeObjectForKey:type];
+            return;
+        }
+        
+        uLong dictionaryID = adler32(adler32(0L, Z_NULL, 0), dictionary.bytes, (uInt)dictionary.length);
+        
+        _compressionDictionaries[type] = [dictionary copy];
+        _compressionDictionariesByID[@(dictionaryID)] = _compressionDictionaries[type];
+    }
+}
+
+- (BOOL)flushAccessDates
+{
+    NSDictionary *accesses = [self pmd_dequeuePendingAccesses];
+    
+    if (accesses.count == 0)
+        return YES;
+    
     __block BOOL succeed = YES;
     
     [_dbQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
         @try
         {
-            [db executeUpdate:@"DROP TABLE Objects"];
-            [db executeUpdate:@"DROP TABLE Data"];
-            [db executeUpdate:@"CREATE TABLE Objects (id INTEGER PRIMARY KEY AUTOINCREMENT, key TEXT UNIQUE NOT NULL, creationDate REAL, type TEXT, updateDate REAL, accessDate REAL)"];
-            [db executeUpdate:@"CREATE TABLE Data (id INTEGER PRIMARY KEY, data BLOB, FOREIGN KEY(id) REFERENCES Objects(id))"];
+            if (![self pmd_writeAccesses:accesses inDatabase:db])
+                @throw UpdateException;
         }
         @catch (NSException *exception)
         {
@@ -402,24 +911,48 @@ static NSString * const PMSQLiteStoreUpdateException = @"PMSQLiteStoreUpdateExce
         }
     }];
     
+    if (!succeed)
+        [self pmd_requeuePendingAccesses:accesses];
+    
     return succeed;
 }
 
-- (BOOL)pmd_insertEmptyPersistentObject:(PMSQLiteObject*)object
+#pragma mark Private Methods
+
+- (void)pmd_didChangePersistentObject:(PMSQLiteObject*)object
+{
+    if (object.dbID != NSNotFound)
+    {
+        [_changesLock lock];
+        
+        [_updatedObjects addObject:object];
+        
+        // Queued objects are pinned in the cache until saved.
+        [_cache setObject:object forKey:object.key cost:0];
+        [_cache pinObjectForKey:object.key];
+        
+        [_changesLock unlock];
+    }
+}
+
+- (BOOL)pmd_createTables
 {
     __block BOOL succeed = YES;
     
     [_dbQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
-        
         @try
         {
-            if (![db executeUpdate:@"INSERT INTO Objects (key, creationDate) values (?, ?)", object.key, @([[NSDate date] timeIntervalSince1970])])
+            [db executeUpdate:@"DROP TABLE Objects"];
+            [db executeUpdate:@"DROP TABLE Data"];
+            
+            if (![db executeUpdate:@"CREATE TABLE Objects (id INTEGER PRIMARY KEY AUTOINCREMENT, key TEXT UNIQUE NOT NULL, creationDate REAL, type TEXT, updateDate REAL, accessDate REAL, data BLOB)"])
                 @throw UpdateException;
             
-            sqlite_int64 dbID = db.lastInsertRowId;
-            object.dbID = (long)dbID;
+            if (![self pmd_createIndexesInDatabase:db])
+                @throw UpdateException;
             
-            if(![db executeUpdate:@"INSERT INTO Data (id) values (?)", @(dbID)])
+            // New stores start with the current schema: there is nothing to migrate.
+            if (![db executeUpdate:[NSString stringWithFormat:@"PRAGMA user_version = %ld", (long)PMSQLiteStoreSchemaVersion]])
                 @throw UpdateException;
         }
         @catch (NSException *exception)
@@ -436,27 +969,41 @@ static NSString * const PMSQLiteStoreUpdateException = @"PMSQLiteStoreUpdateExce
     return succeed;
 }
 
-- (BOOL)pmd_insertPersistentObject:(PMSQLiteObject*)object
+- (BOOL)pmd_migrateSchema
 {
     __block BOOL succeed = YES;
     
     [_dbQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
-        
         @try
         {
-            if (![db executeUpdate:@"INSERT INTO Objects (key, creationDate, type, updateDate, accessDate) values (?, ?, ?, ?, ?)",
-                 object.key,
-                 @([[NSDate date] timeIntervalSince1970]),
-                 object.type,
-                 object.lastUpdate,
-                 object.lastUpdate
-                 ])
-                @throw UpdateException;
+            NSInteger version = 0;
+            
+            FMResultSet *resultSet = [db executeQuery:@"PRAGMA user_version"];
+            if ([resultSet next])
+                version = [resultSet intForColumnIndex:0];
+            [resultSet close];
+            
+            if (version >= PMSQLiteStoreSchemaVersion)
+                return;
+            
+            // Version 4 moves the data into the Objects table: point reads and writes touch a single row, without joins.
+            if (version < 4)
+            {
+                if (![db executeUpdate:@"ALTER TABLE Objects ADD COLUMN data BLOB"])
+                    @throw UpdateException;
+                
+                if (![db executeUpdate:@"UPDATE Objects SET data = (SELECT Data.data FROM Data WHERE Data.id = Objects.id)"])
+                    @throw UpdateException;
+                
+                if (![db executeUpdate:@"DROP TABLE Data"])
+                    @throw UpdateException;
+            }
             
-            sqlite_int64 dbID = db.lastInsertRowId;
-            object.dbID = (long)dbID;
+            // Indexes of versions 2 (by type and date), 3 (by type and key), 4 (keys by type and update date) and 5 (no date indexes without type).
+            if (![self pmd_createIndexesInDatabase:db])
+                @throw UpdateException;
             
-            if(![db executeUpdate:@"INSERT INTO Data (id, data) values (?, ?)", @(dbID), object.data])
+            if (![db executeUpdate:[NSString stringWithFormat:@"PRAGMA user_version = %ld", (long)PMSQLiteStoreSchemaVersion]])
                 @throw UpdateException;
         }
         @catch (NSException *exception)
@@ -467,26 +1014,24 @@ static NSString * const PMSQLiteStoreUpdateException = @"PMSQLiteStoreUpdateExce
                 *rollback = YES;
             else
                 @throw exception;
-        }        
+        }
     }];
     
     return succeed;
 }
 
-- (BOOL)pmd_updatePersistentObject:(PMSQLiteObject*)object
+- (BOOL)pmd_insertEmptyPersistentObject:(PMSQLiteObject*)object
 {
-    NSAssert(object.dbID != NSNotFound, @"PersistentObject must have a valid database identifier.");
-    
     __block BOOL succeed = YES;
     
     [_dbQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
+        
         @try
         {
-            if (![db executeUpdate:@"UPDATE Objects SET type = ?, updateDate = ? WHERE id = ?", object.type, object.lastUpdate, @(object.dbID)])
+            if (![db executeUpdate:@"INSERT INTO Objects (key, creationDate) values (?, ?)", object.key, @([[NSDate date] timeIntervalSince1970])])
                 @throw UpdateException;
             
-            if(![db executeUpdate:@"UPDATE Data SET data = ? WHERE id = ?", object.data, @(object.dbID)])
-                @throw UpdateException;
+            object.dbID = (long)db.lastInsertRowId;
         }
         @catch (NSException *exception)
         {
@@ -502,58 +1047,410 @@ static NSString * const PMSQLiteStoreUpdateException = @"PMSQLiteStoreUpdateExce
     return succeed;
 }
 
-- (BOOL)pmd_deletePersistentObject:(PMSQLiteObject*)object
+- (BOOL)pmd_createIndexesInDatabase:(FMDatabase*)db
 {
-    __block BOOL succeed = YES;
+    // Queries and deletions by type and date. The (type, updateDate) index of version 2 is replaced by one including the key,
+    // so keys of objects updated since a date are read from the index and not from the table rows holding the data.
+    if (![db executeUpdate:@"DROP INDEX IF EXISTS ObjectsTypeUpdateDate"])
+        return NO;
     
-    [_dbQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
-        @try
-        {
-            if (![db executeUpdate:@"DELETE FROM Data WHERE id = ?", @(object.dbID)])
-                @throw UpdateException;
+    if (![db executeUpdate:@"CREATE INDEX IF NOT EXISTS ObjectsTypeUpdateDateKey ON Objects (type, updateDate, key)"])
+        return NO;
+    
+    if (![db executeUpdate:@"CREATE INDEX IF NOT EXISTS ObjectsTypeAccessDate ON Objects (type, accessDate)"])
+        return NO;
+    
+    if (![db executeUpdate:@"CREATE INDEX IF NOT EXISTS ObjectsTypeCreationDate ON Objects (type, creationDate)"])
+        return NO;
+    
+    // Date indexes without type served only deletions of all types, a rare purge not worth updating three more indexes on every write:
+    // such deletions scan the table instead.
+    if (![db executeUpdate:@"DROP INDEX IF EXISTS ObjectsUpdateDate"])
+        return NO;
+    
+    if (![db executeUpdate:@"DROP INDEX IF EXISTS ObjectsAccessDate"])
+        return NO;
+    
+    if (![db executeUpdate:@"DROP INDEX IF EXISTS ObjectsCreationDate"])
+        return NO;
+    
+    // Enumerations and counts by type sorted by key.
+    return [db executeUpdate:@"CREATE INDEX IF NOT EXISTS ObjectsTypeKey ON Objects (type, key)"];
+}
 
-            if (![db executeUpdate:@"DELETE FROM Objects WHERE id = ?", @(object.dbID)])
-                @throw UpdateException;
-        }
-        @catch (NSException *exception)
-        {
-            succeed = NO;
+- (BOOL)pmd_insertPersistentObject:(PMSQLiteObject*)object creationDate:(NSNumber*)creationDate inDatabase:(FMDatabase*)db
+{
+    NSData *data = [self pmd_storedDataWithData:object.data ofType:object.type];
+    PMMetricsIncrement(PMMetricSQLiteBytesWritten, data.length);
+    
+    if (![db executeUpdate:@"INSERT INTO Objects (key, creationDate, type, updateDate, accessDate, data) values (?, ?, ?, ?, ?, ?)",
+         object.key,
+         creationDate,
+         object.type,
+         object.lastUpdate,
+         object.lastUpdate,
+         data
+         ])
+        return NO;
+    
+    object.dbID = (long)db.lastInsertRowId;
+    
+    return YES;
+}
+
+- (BOOL)pmd_updatePersistentObject:(PMSQLiteObject*)object inDatabase:(FMDatabase*)db
+{
+    NSAssert(object.dbID != NSNotFound, @"PersistentObject must have a valid database identifier.");
+    
+    NSData *data = [self pmd_storedDataWithData:object.data ofType:object.type];
+    PMMetricsIncrement(PMMetricSQLiteBytesWritten, data.length);
+    
+    return [db executeUpdate:@"UPDATE Objects SET type = ?, updateDate = ?, data = ? WHERE id = ?", object.type, object.lastUpdate, data, @(object.dbID)];
+}
+
+- (BOOL)pmd_deletePersistentObject:(PMSQLiteObject*)object inDatabase:(FMDatabase*)db
+{
+    return [db executeUpdate:@"DELETE FROM Objects WHERE id = ?", @(object.dbID)];
+}
+
+- (void)pmd_inReaderDatabase:(void (^)(FMDatabase *db))block
+{
+    NSTimeInterval waitStart = PMMetricsStart();
+    
+    void (^readBlock)(FMDatabase *db) = ^(FMDatabase *db) {
+        PMMetricsRecordDuration(PMMetricSQLiteReadWait, waitStart);
+        
+        NSTimeInterval readStart = PMMetricsStart();
+        block(db);
+        PMMetricsRecordDuration(PMMetricSQLiteRead, readStart);
+    };
+    
+    if (_readerPool)
+    {
+        __block BOOL didRead = NO;
+        
+        dispatch_semaphore_wait(_readerSemaphore, DISPATCH_TIME_FOREVER);
+        
+        [_readerPool inDatabase:^(FMDatabase *db) {
+            if (!db)
+                return;
             
-            if ([exception.name isEqualToString:PMSQLiteStoreUpdateException])
-                *rollback = YES;
-            else
-                @throw exception;
-        }
-    }];
+            db.shouldCacheStatements = YES;
+            readBlock(db);
+            didRead = YES;
+        }];
+        
+        dispatch_semaphore_signal(_readerSemaphore);
+        
+        // The pool failed to open a connection: read from the writer connection.
+        if (!didRead)
+            [_dbQueue inDatabase:readBlock];
+    }
+    else
+        [_dbQueue inDatabase:readBlock];
+}
+
+- (NSString*)pmd_parametersStringWithCount:(NSUInteger)count
+{
+    NSMutableString *string = [NSMutableString stringWithCapacity:count * 2];
     
-    return succeed;
+    for (NSUInteger i = 0; i < count; ++i)
+        [string appendString:(i == 0 ? @"?" : @",?")];
+    
+    return string;
 }
 
-- (BOOL)pmd_didAccessObjectWithID:(NSInteger)dbID
+- (NSMutableArray*)pmd_cachedPersistentObjects:(NSArray*)persistentObjects
 {
-    if (dbID == NSNotFound)
-        return NO;
+    NSMutableArray *array = [NSMutableArray arrayWithCapacity:persistentObjects.count];
     
-    __block BOOL succeed = YES;
+    // Objects are read outside any lock: objects cached meanwhile, maybe changed and queued by a save, win over the read ones.
+    for (PMSQLiteObject *persistentObject in persistentObjects)
+        [array addObject:[_cache setObjectIfAbsent:persistentObject forKey:persistentObject.key cost:persistentObject.data.length]];
     
-    [_dbQueue inTransaction:^(FMDatabase *db, BOOL *rollback) {
-        @try
+    return array;
+}
+
+- (PMSQLiteObject*)pmd_persistentObjectFromResultSet:(FMResultSet*)resultSet
+{
+    // Columns: id, key, type, updateDate, accessDate, data
+    PMSQLiteObject *persistentObject = [[PMSQLiteObject alloc] initWithDataBaseIdentifier:[resultSet intForColumnIndex:0]];
+    persistentObject.key = [resultSet stringForColumnIndex:1];
+    persistentObject.type = [resultSet stringForColumnIndex:2];
+    persistentObject.lastUpdate = [NSDate dateWithTimeIntervalSince1970:[resultSet doubleForColumnIndex:3]];
+    persistentObject.lastAccessTime = [resultSet doubleForColumnIndex:4];
+    
+    NSString *failureReason = nil;
+    persistentObject.data = [self pmd_dataWithStoredData:[resultSet dataForColumnIndex:5] failureReason:&failureReason];
+    
+    // Loaded values are not changes.
+    [persistentObject pmd_setHasChanges:NO];
+    
+    persistentObject.persistentStore = self;
+    
+    // The database is in use: the failure is reported once released, so observers can use the store.
+    if (failureReason)
+    {
+        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            [self pmd_postFailureWithCode:PMPersistentStoreErrorCodeCorruptedData reason:failureReason persistentObject:persistentObject];
+        });
+    }
+    
+    return persistentObject;
+}
+
+- (NSData*)pmd_storedDataWithData:(NSData*)data ofType:(NSString*)type
+{
+    if (!data)
+        return nil;
+    
+    BOOL compresses = _compressesData;
+    NSData *dictionary = nil;
+    
+    @synchronized(_compressedTypes)
+    {
+        NSNumber *flag = _compressedTypes[type];
+        
+        if (flag)
+            compresses = flag.boolValue;
+        
+        dictionary = _compressionDictionaries[type];
+    }
+    
+    BOOL hasMagic = data.length >= sizeof(PMSQLiteStoreCompressionMagic) && memcmp(data.bytes, PMSQLiteStoreCompressionMagic, sizeof(PMSQLiteStoreCompressionMagic)) == 0;
+    
+    if (compresses && data.length >= _compressionThreshold && data.length <= UINT32_MAX)
+    {
+        NSData *compressedData = [self pmd_compressedData:data dictionary:dictionary];
+        
+        // Incompressible data is stored as is.
+        if (compressedData && compressedData.length < data.length)
+            return compressedData;
+    }
+    
+    if (!hasMagic)
+        return data;
+    
+    // Uncompressed data looking like a compressed blob must be escaped.
+    NSMutableData *storedData = [NSMutableData dataWithCapacity:PMSQLiteStoreCompressionHeaderLength + data.length];
+    [self pmd_appendCompressionHeaderWithCodec:PMSQLiteStoreCompressionCodecNone length:data.length toData:storedData];
+    [storedData appendData:data];
+    
+    return storedData;
+}
+
+- (NSData*)pmd_dataWithStoredData:(NSData*)storedData failureReason:(NSString**)failureReason
+{
+    PMMetricsIncrement(PMMetricSQLiteBytesRead, storedData.length);
+    
+    if (storedData.length < PMSQLiteStoreCompressionHeaderLength || memcmp(storedData.bytes, PMSQLiteStoreCompressionMagic, sizeof(PMSQLiteStoreCompressionMagic)) != 0)
+        return storedData;
+    
+    const uint8_t *bytes = storedData.bytes;
+    uint32_t length = (uint32_t)bytes[4] | (uint32_t)bytes[5] << 8 | (uint32_t)bytes[6] << 16 | (uint32_t)bytes[7] << 24;
+    
+    NSData *payload = [storedData subdataWithRange:NSMakeRange(PMSQLiteStoreCompressionHeaderLength, storedData.length - PMSQLiteStoreCompressionHeaderLength)];
+    
+    switch (bytes[3])
+    {
+        case PMSQLiteStoreCompressionCodecNone:
+            return payload;
+            
+        case PMSQLiteStoreCompressionCodecZlib:
+            return [self pmd_decompressedData:payload length:length failureReason:failureReason];
+            
+        default:
+            *failureReason = [NSString stringWithFormat:@"Unknown compression codec %d.", bytes[3]];
+            return nil;
+    }
+}
+
+- (void)pmd_appendCompressionHeaderWithCodec:(PMSQLiteStoreCompressionCodec)codec length:(NSUInteger)length toData:(NSMutableData*)data
+{
+    uint8_t header[PMSQLiteStoreCompressionHeaderLength];
+    
+    memcpy(header, PMSQLiteStoreCompressionMagic, sizeof(PMSQLiteStoreCompressionMagic));
+    header[3] = codec;
+    header[4] = length & 0xFF;
+    header[5] = (length >> 8) & 0xFF;
+    header[6] = (length >> 16) & 0xFF;
+    header[7] = (length >> 24) & 0xFF;
+    
+    [data appendBytes:header length:sizeof(header)];
+}
+
+- (NSData*)pmd_compressedData:(NSData*)data dictionary:(NSData*)dictionary
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    
+    if (deflateInit(&stream, Z_DEFAULT_COMPRESSION) != Z_OK)
+        return nil;
+    
+    if (dictionary && deflateSetDictionary(&stream, dictionary.bytes, (uInt)dictionary.length) != Z_OK)
+    {
+        deflateEnd(&stream);
+        return nil;
+    }
+    
+    uLong bound = deflateBound(&stream, data.length);
+    
+    NSMutableData *compressedData = [NSMutableData dataWithCapacity:PMSQLiteStoreCompressionHeaderLength + bound];
+    [self pmd_appendCompressionHeaderWithCodec:PMSQLiteStoreCompressionCodecZlib length:data.length toData:compressedData];
+    compressedData.length = PMSQLiteStoreCompressionHeaderLength + bound;
+    
+    stream.next_in = (Bytef*)data.bytes;
+    stream.avail_in = (uInt)data.length;
+    stream.next_out = (Bytef*)compressedData.mutableBytes + PMSQLiteStoreCompressionHeaderLength;
+    stream.avail_out = (uInt)bound;
+    
+    int status = deflate(&stream, Z_FINISH);
+    deflateEnd(&stream);
+    
+    if (status != Z_STREAM_END)
+        return nil;
+    
+    compressedData.length = PMSQLiteStoreCompressionHeaderLength + stream.total_out;
+    
+    return compressedData;
+}
+
+- (NSData*)pmd_decompressedData:(NSData*)data length:(NSUInteger)length failureReason:(NSString**)failureReason
+{
+    // The output buffer is allocated from the header: a corrupted length must not trigger a huge allocation.
+    if (length > PMSQLiteStoreMaximumCompressionRatio * data.length + PMSQLiteStoreCompressionHeaderLength)
+    {
+        *failureReason = [NSString stringWithFormat:@"Invalid uncompressed length %lu for %lu bytes of compressed data.", (unsigned long)length, (unsigned long)data.length];
+        return nil;
+    }
+    
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    
+    if (inflateInit(&stream) != Z_OK)
+    {
+        *failureReason = @"Cannot initialize the decompression stream.";
+        return nil;
+    }
+    
+    NSMutableData *decompressedData = [NSMutableData dataWithLength:length];
+    
+    stream.next_in = (Bytef*)data.bytes;
+    stream.avail_in = (uInt)data.length;
+    stream.next_out = decompressedData.mutableBytes;
+    stream.avail_out = (uInt)length;
+    
+    int status = inflate(&stream, Z_FINISH);
+    
+    if (status == Z_NEED_DICT)
+    {
+        // The stream identifies its dictionary by its adler32 checksum.
+        NSData *dictionary = nil;
+        
+        @synchronized(_compressedTypes)
         {
-            if(![db executeUpdate:@"UPDATE Objects SET accessDate = ? WHERE id = ?", @([[NSDate date] timeIntervalSince1970]), @(dbID)])
-                @throw UpdateException;
+            dictionary = _compressionDictionariesByID[@(stream.adler)];
         }
-        @catch (NSException *exception)
+        
+        if (!dictionary)
         {
-            succeed = NO;
-            
-            if ([exception.name isEqualToString:PMSQLiteStoreUpdateException])
-                *rollback = YES;
-            else
-                @throw exception;
+            inflateEnd(&stream);
+            *failureReason = @"Missing compression dictionary to decompress data.";
+            return nil;
         }
-    }];
+        
+        if (inflateSetDictionary(&stream, dictionary.bytes, (uInt)dictionary.length) == Z_OK)
+            status = inflate(&stream, Z_FINISH);
+    }
     
-    return succeed;
+    inflateEnd(&stream);
+    
+    if (status != Z_STREAM_END || stream.total_out != length)
+    {
+        *failureReason = [NSString stringWithFormat:@"Cannot decompress data (zlib status %d).", status];
+        return nil;
+    }
+    
+    return decompressedData;
+}
+
+- (void)pmd_didAccessPersistentObject:(PMSQLiteObject*)object
+{
+    if (_accessTracking == PMAccessTrackingNone || object.dbID == NSNotFound)
+        return;
+    
+    NSTimeInterval now = [[NSDate date] timeIntervalSince1970];
+    
+    if (_accessTracking == PMAccessTrackingCoarse && now - object.lastAccessTime < _accessTrackingInterval)
+        return;
+    
+    object.lastAccessTime = now;
+    
+    BOOL shouldScheduleFlush = NO;
+    
+    @synchronized(_pendingAccesses)
+    {
+        _pendingAccesses[@(object.dbID)] = @(now);
+        
+        shouldScheduleFlush = !_isAccessFlushScheduled;
+        _isAccessFlushScheduled = YES;
+    }
+    
+    if (shouldScheduleFlush)
+    {
+        __weak PMSQLiteStore *weakSelf = self;
+        dispatch_time_t time = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(_accessFlushInterval * NSEC_PER_SEC));
+        dispatch_after(time, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0), ^{
+            [weakSelf flushAccessDates];
+        });
+    }
+}
+
+- (NSDictionary*)pmd_dequeuePendingAccesses
+{
+    @synchronized(_pendingAccesses)
+    {
+        NSDictionary *accesses = [_pendingAccesses copy];
+        [_pendingAccesses removeAllObjects];
+        _isAccessFlushScheduled = NO;
+        return accesses;
+    }
+}
+
+- (void)pmd_requeuePendingAccesses:(NSDictionary*)accesses
+{
+    @synchronized(_pendingAccesses)
+    {
+        for (NSNumber *dbID in accesses)
+        {
+            // Do not overwrite newer accesses recorded in the meantime.
+            if (!_pendingAccesses[dbID])
+                _pendingAccesses[dbID] = accesses[dbID];
+        }
+    }
+}
+
+- (void)pmd_postFailureWithCode:(PMPersistentStoreErrorCode)code reason:(NSString*)reason persistentObject:(PMSQLiteObject*)persistentObject
+{
+    NSError *error = [NSError errorWithDomain:PMPersistentStoreErrorDomain code:code userInfo:@{NSLocalizedFailureReasonErrorKey : reason ?: @""}];
+    
+    NSMutableDictionary *userInfo = [NSMutableDictionary dictionaryWithObject:error forKey:PMPersistentStoreErrorKey];
+    
+    if (persistentObject)
+        userInfo[PMPersistentStoreObjectKey] = persistentObject;
+    
+    [[NSNotificationCenter defaultCenter] postNotificationName:PMPersistentStoreDidFailNotification object:self userInfo:userInfo];
+}
+
+- (BOOL)pmd_writeAccesses:(NSDictionary*)accesses inDatabase:(FMDatabase*)db
+{
+    for (NSNumber *dbID in accesses)
+    {
+        if (![db executeUpdate:@"UPDATE Objects SET accessDate = ? WHERE id = ?", accesses[dbID], dbID])
+            return NO;
+    }
+    
+    return YES;
 }
 
 @end
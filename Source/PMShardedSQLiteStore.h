@@ -0,0 +1,75 @@
+//
+//  PMShardedSQLiteStore.h
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import "PMPersistentStore.h"
+
+/**
+ * Persistent store that distributes the objects among multiple SQLite databases, hashing their keys.
+ *
+ * The url of the store is a directory containing one `PMSQLiteStore` database file per shard and a manifest recording the number of shards.
+ * Each shard has its own connection: saves commit all shards in parallel, and queries by type or deletions are performed in all shards in parallel and merged.
+ *
+ * Saves are not atomic across shards: each shard commits its own transaction. If `save` returns NO, the changes of the shards that succeeded are committed and the changes of the failed shards are not.
+ *
+ * Pages cost more than in a single database: `persistentObjectsOfType:offset:limit:order:` reads the first `offset + limit` objects of every shard, data included, to merge them, and all of them are considered accessed, not only the returned page. Deep pages read almost the whole type: enumerate with `persistentObjectsOfType:afterKey:limit:` instead, which reads at most `limit` objects per shard.
+ **/
+@interface PMShardedSQLiteStore : PMPersistentStore
+
+
+/** ---------------------------------------------------------------- **
+ *  @name Creating instances and initializing
+ ** ---------------------------------------------------------------- **/
+
+/**
+ * Initializes the store with the number of active processors as number of shards.
+ * @param url The url of the store directory. Cannot be nil.
+ * @return The initialized instance.
+ **/
+- (id)initWithURL:(NSURL*)url;
+
+/**
+ * Default initializer.
+ * @param url The url of the store directory. Cannot be nil.
+ * @param shardCount The number of shards of a new store. Must be greater than zero.
+ * @return The initialized instance.
+ * @discussion The number of shards is fixed when the store is created and recorded in the manifest. When opening an existing store, the recorded number of shards is used and `shardCount` is ignored.
+ **/
+- (id)initWithURL:(NSURL*)url shardCount:(NSUInteger)shardCount;
+
+
+/** ---------------------------------------------------------------- **
+ *  @name Managing the Store
+ ** ---------------------------------------------------------------- **/
+
+/**
+ * The number of shards.
+ **/
+@property (nonatomic, assign, readonly) NSUInteger shardCount;
+
+/**
+ * The `PMSQLiteStore` of each shard. Use them to configure caches and access tracking.
+ **/
+@property (nonatomic, strong, readonly) NSArray *shards;
+
+@end
@@ -0,0 +1,375 @@
+//
+//  PMShardedSQLiteStore.m
+//  Created by Joan Martin.
+//  Take a look to my repos at http://github.com/vilanovi
+//
+// Copyright (c) 2013 Joan Martin, vilanovi@gmail.com.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is furnished to do
+// so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+// PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+// OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+// SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE
+
+#import "PMShardedSQLiteStore.h"
+
+#import "PMSQLiteStore.h"
+#import "PMPersistentObject.h"
+
+static NSString * const PMShardedSQLiteStoreManifestFileName = @"manifest.plist";
+static NSString * const PMShardedSQLiteStoreManifestVersionKey = @"version";
+static NSString * const PMShardedSQLiteStoreManifestShardCountKey = @"shardCount";
+
+static NSInteger const PMShardedSQLiteStoreManifestVersion = 1;
+
+static uint64_t hashFromKey(NSString *key)
+{
+    // FNV-1a: the shard of a key must never change between runs nor platforms.
+    const char *bytes = [key UTF8String];
+    uint64_t hash = 14695981039346656037ULL;
+    
+    for (; *bytes != '\0'; ++bytes)
+    {
+        hash ^= (uint8_t)*bytes;
+        hash *= 1099511628211ULL;
+    }
+    
+    return hash;
+}
+
+static NSComparisonResult compareKeys(NSString *key1, NSString *key2)
+{
+    // Same order as SQLite compares text: by UTF-8 bytes.
+    int result = strcmp([key1 UTF8String], [key2 UTF8String]);
+    
+    if (result < 0)
+        return NSOrderedAscending;
+    else if (result > 0)
+        return NSOrderedDescending;
+    
+    return NSOrderedSame;
+}
+
+@implementation PMShardedSQLiteStore
+
+- (id)initWithURL:(NSURL*)url
+{
+    return [self initWithURL:url shardCount:[[NSProcessInfo processInfo] activeProcessorCount]];
+}
+
+- (id)initWithURL:(NSURL*)url shardCount:(NSUInteger)shardCount
+{
+    if (url == nil)
+    {
+        NSString *reason = @"Cannot create a PMShardedSQLiteStore without the url of its directory.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    if (shardCount == 0)
+    {
+        NSString *reason = @"Cannot create a PMShardedSQLiteStore without shards.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    self = [super initWithURL:url];
+    if (self)
+    {
+        NSURL *manifestURL = [url URLByAppendingPathComponent:PMShardedSQLiteStoreManifestFileName];
+        NSDictionary *manifest = [NSDictionary dictionaryWithContentsOfURL:manifestURL];
+        
+        if (manifest)
+        {
+            _shardCount = [manifest[PMShardedSQLiteStoreManifestShardCountKey] unsignedIntegerValue];
+            
+            if (_shardCount == 0)
+                return nil;
+        }
+        else
+        {
+            if (![[NSFileManager defaultManager] createDirectoryAtURL:url withIntermediateDirectories:YES attributes:nil error:nil])
+                return nil;
+            
+            _shardCount = shardCount;
+            
+            manifest = @{PMShardedSQLiteStoreManifestVersionKey: @(PMShardedSQLiteStoreManifestVersion),
+                         PMShardedSQLiteStoreManifestShardCountKey: @(_shardCount),
+                         };
+            
+            if (![manifest writeToURL:manifestURL atomically:YES])
+                return nil;
+        }
+        
+        NSMutableArray *shards = [NSMutableArray arrayWithCapacity:_shardCount];
+        
+        for (NSUInteger i = 0; i < _shardCount; ++i)
+        {
+            NSString *fileName = [NSString stringWithFormat:@"shard-%03lu.sqlite", (unsigned long)i];
+            [shards addObject:[[PMSQLiteStore alloc] initWithURL:[url URLByAppendingPathComponent:fileName]]];
+        }
+        
+        _shards = [shards copy];
+    }
+    return self;
+}
+
+#pragma mark Super Methods
+
+- (id<PMPersistentObject>)persistentObjectWithKey:(NSString*)key
+{
+    return [[self pmd_shardForKey:key] persistentObjectWithKey:key];
+}
+
+- (NSArray*)persistentObjectsWithKeys:(NSArray*)keys
+{
+    if (keys == nil)
+    {
+        NSString *reason = @"Cannot query for persistent objects with a nil array of keys.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    NSMutableArray *keysByShard = [NSMutableArray arrayWithCapacity:_shardCount];
+    
+    for (NSUInteger i = 0; i < _shardCount; ++i)
+        [keysByShard addObject:[NSMutableArray array]];
+    
+    for (NSString *key in keys)
+        [keysByShard[hashFromKey(key) % _shardCount] addObject:key];
+    
+    return [self pmd_mergedResultsOfBlock:^NSArray *(PMSQLiteStore *shard, NSUInteger index) {
+        NSArray *shardKeys = keysByShard[index];
+        
+        if (shardKeys.count == 0)
+            return @[];
+        
+        return [shard persistentObjectsWithKeys:shardKeys];
+    }];
+}
+
+- (NSArray*)persistentObjectsOfType:(NSString*)type
+{
+    if (type == nil)
+    {
+        NSString *reason = @"Cannot query for persistent objects with a nil type.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    return [self pmd_mergedResultsOfBlock:^NSArray *(PMSQLiteStore *shard, NSUInteger index) {
+        return [shard persistentObjectsOfType:type];
+    }];
+}
+
+- (NSArray*)persistentObjectsOfType:(NSString*)type includesData:(BOOL)includesData
+{
+    if (type == nil)
+    {
+        NSString *reason = @"Cannot query for persistent objects with a nil type.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    return [self pmd_mergedResultsOfBlock:^NSArray *(PMSQLiteStore *shard, NSUInteger index) {
+        return [shard persistentObjectsOfType:type includesData:includesData];
+    }];
+}
+
+- (NSArray*)persistentObjectsOfType:(NSString*)type offset:(NSUInteger)offset limit:(NSUInteger)limit order:(PMOptionOrder)order
+{
+    if (type == nil)
+    {
+        NSString *reason = @"Cannot query for persistent objects with a nil type.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    // Each shard returns its first objects up to the end of the page, then the page is taken from the merge.
+    NSUInteger shardLimit = (limit > NSUIntegerMax - offset) ? NSUIntegerMax : offset + limit;
+    
+    NSArray *objects = [self pmd_mergedResultsOfBlock:^NSArray *(PMSQLiteStore *shard, NSUInteger index) {
+        return [shard persistentObjectsOfType:type offset:0 limit:shardLimit order:order];
+    }];
+    
+    objects = [objects sortedArrayUsingComparator:^NSComparisonResult(id<PMPersistentObject> object1, id<PMPersistentObject> object2) {
+        if (order == PMOptionOrderByUpdateDate)
+        {
+            NSComparisonResult result = [object1.lastUpdate compare:object2.lastUpdate];
+            
+            if (result != NSOrderedSame)
+                return result;
+        }
+        
+        return compareKeys(object1.key, object2.key);
+    }];
+    
+    if (offset >= objects.count)
+        return @[];
+    
+    return [objects subarrayWithRange:NSMakeRange(offset, MIN(limit, objects.count - offset))];
+}
+
+- (NSArray*)persistentObjectsOfType:(NSString*)type afterKey:(NSString*)key limit:(NSUInteger)limit
+{
+    if (type == nil)
+    {
+        NSString *reason = @"Cannot query for persistent objects with a nil type.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    NSArray *objects = [self pmd_mergedResultsOfBlock:^NSArray *(PMSQLiteStore *shard, NSUInteger index) {
+        return [shard persistentObjectsOfType:type afterKey:key limit:limit];
+    }];
+    
+    objects = [objects sortedArrayUsingComparator:^NSComparisonResult(id<PMPersistentObject> object1, id<PMPersistentObject> object2) {
+        return compareKeys(object1.key, object2.key);
+    }];
+    
+    return [objects subarrayWithRange:NSMakeRange(0, MIN(limit, objects.count))];
+}
+
+- (NSUInteger)countOfObjectsOfType:(NSString*)type
+{
+    if (type == nil)
+    {
+        NSString *reason = @"Cannot count persistent objects with a nil type.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return 0;
+    }
+    
+    __block NSUInteger count = 0;
+    
+    NSLock *lock = [[NSLock alloc] init];
+    
+    dispatch_apply(_shardCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t index) {
+        NSUInteger shardCount = [_shards[index] countOfObjectsOfType:type];
+        
+        [lock lock];
+        count += shardCount;
+        [lock unlock];
+    });
+    
+    return count;
+}
+
+- (NSArray*)keysOfType:(NSString*)type updatedSince:(NSDate*)date
+{
+    if (type == nil)
+    {
+        NSString *reason = @"Cannot query for keys with a nil type.";
+        NSException *exception = [NSException exceptionWithName:NSInvalidArgumentException reason:reason userInfo:nil];
+        [exception raise];
+        return nil;
+    }
+    
+    return [self pmd_mergedResultsOfBlock:^NSArray *(PMSQLiteStore *shard, NSUInteger index) {
+        return [shard keysOfType:type updatedSince:date];
+    }];
+}
+
+- (NSDate*)lastUpdateForKey:(NSString*)key
+{
+    return [[self pmd_shardForKey:key] lastUpdateForKey:key];
+}
+
+- (id<PMPersistentObject>)createPersistentObjectWithKey:(NSString*)key ofType:(NSString*)type
+{
+    return [[self pmd_shardForKey:key] createPersistentObjectWithKey:key ofType:type];
+}
+
+- (void)deletePersistentObjectWithKey:(NSString*)key
+{
+    [[self pmd_shardForKey:key] deletePersistentObjectWithKey:key];
+}
+
+- (BOOL)deleteEntriesOfType:(NSString*)type olderThan:(NSDate*)date policy:(PMOptionDelete)option
+{
+    return [self pmd_allShardsSucceedInBlock:^BOOL(PMSQLiteStore *shard) {
+        return [shard deleteEntriesOfType:type olderThan:date policy:option];
+    }];
+}
+
+- (BOOL)save
+{
+    // Each shard commits its own transaction, in parallel with the other shards: a failed shard doesn't roll back the others.
+    return [self pmd_allShardsSucceedInBlock:^BOOL(PMSQLiteStore *shard) {
+        return [shard save];
+    }];
+}
+
+#pragma mark Private Methods
+
+- (PMSQLiteStore*)pmd_shardForKey:(NSString*)key
+{
+    // Nil keys are handed to the first shard, which raises the proper exception.
+    if (key == nil)
+        return _shards.firstObject;
+    
+    return _shards[hashFromKey(key) % _shardCount];
+}
+
+/**
+ * Exceptions can't be caught out of `dispatch_apply`: arguments must be validated before calling the shards.
+ **/
+- (NSArray*)pmd_mergedResultsOfBlock:(NSArray* (^)(PMSQLiteStore *shard, NSUInteger index))block
+{
+    __strong NSArray **results = (__strong NSArray **)calloc(_shardCount, sizeof(NSArray*));
+    
+    dispatch_apply(_shardCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t index) {
+        results[index] = block(_shards[index], index);
+    });
+    
+    NSMutableArray *array = [NSMutableArray array];
+    
+    for (NSUInteger i = 0; i < _shardCount; ++i)
+    {
+        if (results[i])
+            [array addObjectsFromArray:results[i]];
+        
+        results[i] = nil;
+    }
+    
+    free(results);
+    
+    return array;
+}
+
+- (BOOL)pmd_allShardsSucceedInBlock:(BOOL (^)(PMSQLiteStore *shard))block
+{
+    __block BOOL succeed = YES;
+    
+    NSLock *lock = [[NSLock alloc] init];
+    
+    dispatch_apply(_shardCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t index) {
+        BOOL shardSucceed = block(_shards[index]);
+        
+        [lock lock];
+        succeed = succeed && shardSucceed;
+        [lock unlock];
+    });
+    
+    return succeed;
+}
+
+@end
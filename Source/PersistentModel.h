@@ -20,6 +20,16 @@
 
 #import "PMBaseObject.h"
 #import "PMObjectContext.h"
+#import "PMObjectChange.h"
 
 #import "PMPersistentStore.h"
-#import "PMSQLiteStore.h"
\ No newline at end of file
+#import "PMSQLiteStore.h"
+#import "PMShardedSQLiteStore.h"
+#import "PMMemoryStore.h"
+#import "PMLogStore.h"
+
+#import "PMObjectCodec.h"
+#import "PMBinaryCodec.h"
+#import "PMKeyedArchiveCodec.h"
+
+#import "PMMetrics.h"
\ No newline at end of file